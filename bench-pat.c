@@ -0,0 +1,287 @@
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include <util.h>
+#include <pat.h>
+
+#define ROUNDS 100000
+
+/* text pat_scan gets to split */
+#define SCAN_LEN (32 << 20)
+
+struct bench {
+	char *msg;
+	int (*run)(struct pattern *, char const *);
+};
+
+/* linked with --wrap=malloc,--wrap=calloc (see BENCHFLAGS) */
+void *__real_calloc(size_t, size_t);
+void *__real_malloc(size_t);
+void *__wrap_calloc(size_t, size_t);
+void *__wrap_malloc(size_t);
+
+static int run_execute(struct pattern *, char const *);
+static int run_matcher(struct pattern *, char const *);
+static int run_next(struct pattern *, char const *);
+
+static double now(void);
+static void   report(struct bench *, char const *, char const *);
+static void   report_compile(char const *);
+static void   report_hot(char const *, char const *, size_t);
+static void   report_load(char const *);
+static void   report_scan(char const *, char const *, size_t, size_t);
+
+size_t nalloc;
+struct patmatcher *pm;
+
+struct bench benches[] = {
+	{ "pat_execute",      run_execute, },
+	{ "pat_execute_with", run_matcher, },
+	{ "pat_next (all)",   run_next, },
+	{ 0x0 },
+};
+
+void *
+__wrap_calloc(size_t nmemb, size_t size)
+{
+	++nalloc;
+	return __real_calloc(nmemb, size);
+}
+
+void *
+__wrap_malloc(size_t size)
+{
+	++nalloc;
+	return __real_malloc(size);
+}
+
+int
+run_execute(struct pattern *pat, char const *txt)
+{
+	return pat_execute(pat, txt);
+}
+
+int
+run_matcher(struct pattern *pat, char const *txt)
+{
+	return pat_execute_with(pat, pm, txt);
+}
+
+int
+run_next(struct pattern *pat, char const *txt)
+{
+	struct patiter it[1];
+	struct patmatch mat;
+	int err;
+
+	err = pat_iter_init(it, pat, txt, strlen(txt));
+	if (err) return err;
+
+	while (!(err = pat_next(it, &mat))) continue;
+
+	pat_iter_fini(it);
+
+	return err;
+}
+
+double
+now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+void
+report(struct bench *be, char const *src, char const *txt)
+{
+	struct pattern pat[1];
+	double beg;
+	double end;
+	size_t i;
+
+	if (pat_compile(pat, src)) die("pat_compile failed");
+
+	be->run(pat, txt);
+
+	nalloc = 0;
+	beg = now();
+	for (i = 0; i < ROUNDS; ++i) be->run(pat, txt);
+	end = now();
+
+	printf("\t%-18s '%s' … %6.2f mallocs/match, %8.1f ns/match\n",
+	       be->msg, src,
+	       (double)nalloc / ROUNDS,
+	       (end - beg) * 1e9 / ROUNDS);
+
+	pat_free(pat);
+}
+
+void
+report_compile(char const *src)
+{
+	struct pattern pat[1];
+	uint64_t buf[4096];
+	size_t len;
+	size_t heap;
+	double mid;
+	double beg;
+	double end;
+	size_t i;
+
+	nalloc = 0;
+	beg = now();
+	for (i = 0; i < ROUNDS; ++i) {
+		if (pat_compile(pat, src)) die("pat_compile failed");
+		pat_free(pat);
+	}
+	mid = now();
+	heap = nalloc;
+
+	nalloc = 0;
+	for (i = 0; i < ROUNDS; ++i) {
+		len = sizeof buf;
+		if (pat_compile_buf(pat, src, 0, buf, &len)) die("pat_compile_buf failed");
+		pat_free(pat);
+	}
+	end = now();
+
+	printf("	pat_compile_buf    '%s' … %8.1f ns/pattern, %5.2f mallocs; pat_compile %8.1f ns/pattern, %5.2f mallocs\n",
+	       src, (end - mid) * 1e9 / ROUNDS, (double)nalloc / ROUNDS,
+	       (mid - beg) * 1e9 / ROUNDS, (double)heap / ROUNDS);
+}
+
+void
+report_load(char const *src)
+{
+	struct pattern pat[1];
+	uint32_t buf[1024];
+	size_t len = sizeof buf;
+	double mid;
+	double beg;
+	double end;
+	size_t i;
+
+	if (pat_compile(pat, src)) die("pat_compile failed");
+	if (pat_dump(pat, buf, &len)) die("pat_dump failed");
+	pat_free(pat);
+
+	beg = now();
+	for (i = 0; i < ROUNDS; ++i) {
+		if (pat_compile(pat, src)) die("pat_compile failed");
+		pat_free(pat);
+	}
+	mid = now();
+	for (i = 0; i < ROUNDS; ++i) {
+		if (pat_load(pat, buf, len)) die("pat_load failed");
+		pat_free(pat);
+	}
+	end = now();
+
+	printf("\tpat_load           '%s' … %8.1f ns/pattern, pat_compile %8.1f ns/pattern\n",
+	       src, (end - mid) * 1e9 / ROUNDS, (mid - beg) * 1e9 / ROUNDS);
+}
+
+void
+report_hot(char const *src, char const *buf, size_t len)
+{
+	struct pattern pat[1];
+	struct patplan plan;
+	double cold;
+	double beg;
+	double end;
+	size_t i;
+
+	if (pat_compile_flags(pat, src, PAT_JIT)) die("pat_compile_flags failed");
+
+	beg = now();
+	pat_execute_n(pat, buf, len);
+	end = now();
+	cold = end - beg;
+
+	/* enough runs for the search to be compiled */
+	for (i = 0; i < 100; ++i) pat_execute_n(pat, buf, 4096);
+
+	beg = now();
+	pat_execute_n(pat, buf, len);
+	end = now();
+
+	pat_explain(pat, &plan);
+
+	printf("\thot pat_execute_n  '%s' … %8.1f MB/s, cold %8.1f MB/s%s\n",
+	       src, len / (end - beg) / 1e6, len / cold / 1e6,
+	       plan.jit ? ", compiled" : "");
+
+	pat_free(pat);
+}
+
+void
+report_scan(char const *src, char const *buf, size_t len, size_t nthr)
+{
+	struct pattern pat[1];
+	size_t cnt;
+	double beg;
+	double end;
+
+	if (pat_compile(pat, src)) die("pat_compile failed");
+
+	beg = now();
+	if (pat_count(pat, buf, len, nthr, &cnt)) die("pat_count failed");
+	end = now();
+
+	printf("\tpat_count (%zu thr)  '%s' … %8zu matches, %8.1f MB/s\n",
+	       nthr, src, cnt, len / (end - beg) / 1e6);
+
+	pat_free(pat);
+}
+
+int
+main()
+{
+	struct bench *be;
+	char *buf;
+	size_t nthr;
+	size_t i;
+	char const *txt = "GET /index.html HTTP/1.1 from 10.0.0.1";
+
+	pm = pat_matcher_alloc();
+	if (!pm) die("pat_matcher_alloc failed");
+
+	printf("benchmarking pat.c\n");
+
+	for (be = benches; be->msg; ++be) {
+		report(be, "(GET|POST) (/.*)\\.html", txt);
+		report(be, "(GET|POST) (/[a-z.]*) ", txt);
+		report(be, "H(T+)P", txt);
+		report(be, "10\\.0", txt);
+	}
+
+	pat_matcher_free(pm);
+
+	report_compile("(GET|POST) (/.*)\\.html");
+	report_compile("x[0-9]{2,4}y");
+	report_compile("[a-z]+@[a-z]+\\.(com|org|net)");
+	report_compile("(ab){300}$");
+
+	report_load("(GET|POST) (/.*)\\.html");
+	report_load("x[0-9]{2,4}y");
+
+	buf = __real_malloc(SCAN_LEN);
+	if (!buf) die("malloc failed");
+
+	for (i = 0; i < SCAN_LEN; ++i) buf[i] = "abcd efgh\n"[i * 7 % 10];
+
+	report_hot("[a-z]+@[a-z]+\\.com", buf, SCAN_LEN);
+	report_hot("[a-h]{70}z", buf, SCAN_LEN);
+
+	for (nthr = 1; nthr <= 8; nthr *= 2) {
+		report_scan("f[a-h ]*h", buf, SCAN_LEN, nthr);
+		report_scan("hello", buf, SCAN_LEN, nthr);
+	}
+
+	free(buf);
+
+	return 0;
+}
@@ -1,16 +1,21 @@
 CC	?= cc
-CFLAGS	+= -pipe -I. -D_POSIX_C_SOURCE=200809 -D_XOPEN_SOURCE=500 -std=c99 -pedantic -Wall -Wextra \
+CFLAGS	+= -pipe -pthread -I. -D_POSIX_C_SOURCE=200809 -D_XOPEN_SOURCE=500 -std=c99 -pedantic -Wall -Wextra \
 	   -fstrict-aliasing -fstrict-overflow -foptimize-sibling-calls \
 	   -fdata-sections -ffunction-sections -fno-exceptions \
 	   -fno-unwind-tables -fno-asynchronous-unwind-tables \
 	   -fno-stack-protector
 LDFLAGS += -lc -Wl,--sort-section=alignment -Wl,--sort-common
+BENCHFLAGS := -Wl,--wrap=malloc,--wrap=calloc
 
-SRC	:= $(wildcard *.c */*.c)
+PAT	:= $(wildcard *.pat */*.pat)
+GEN	:= $(PAT:.pat=.pat.c)
+SRC	:= $(sort $(wildcard *.c */*.c) $(GEN))
 OBJ	:= $(SRC:.c=.c.o)
 DEP	:= $(wildcard *.d */*.d)
 BIN	:= $(patsubst %.c, %, $(filter %-test.c, $(SRC)))
 TESTS	:= $(patsubst %.c, %, $(filter test-%.c, $(SRC)))
+BENCH	:= $(patsubst %.c, %, $(filter bench-%.c, $(SRC)))
+TOOLS	:= patgen
 
 ifndef NDEBUG
 CFLAGS	+= -O0 -ggdb3 -Werror
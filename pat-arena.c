@@ -0,0 +1,221 @@
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <pat.h>
+#include <pat.ih>
+
+/*
+ * each block from the back has a head in front of it holding where the
+ * back ended before it, with the low bit set once it is given back
+ */
+#define AR_HEAD AR_ALIGN
+
+/* a heap block handed out by an arena that counts */
+struct arblock {
+	struct arblock *next;
+	size_t          prev;
+	bool            freed;
+};
+
+static void  *ar_block(struct arena *, struct arblock **, size_t);
+static void   ar_drop(struct arblock *);
+static size_t ar_round(size_t);
+static void   ar_peak(struct arena *);
+static void   ar_unblock(struct arena *, void *);
+
+void *
+ar_block(struct arena *ar, struct arblock **list, size_t ext)
+{
+	size_t head = ar_round(sizeof (struct arblock));
+	struct arblock *blk;
+
+	blk = calloc(1, head + ext);
+	if (!blk) return 0x0;
+
+	blk->next = *list;
+	blk->prev = ar->hi;
+	*list = blk;
+
+	return (uint8_t *)blk + head;
+}
+
+void
+ar_drop(struct arblock *blk)
+{
+	struct arblock *next;
+
+	for (; blk; blk = next) {
+		next = blk->next;
+		free(blk);
+	}
+}
+
+size_t
+ar_round(size_t n)
+{
+	return (n + AR_ALIGN - 1) / AR_ALIGN * AR_ALIGN;
+}
+
+void
+ar_peak(struct arena *ar)
+{
+	if (ar->lo + ar->hi > ar->peak) ar->peak = ar->lo + ar->hi;
+}
+
+void
+ar_unblock(struct arena *ar, void *ptr)
+{
+	size_t head = ar_round(sizeof (struct arblock));
+	struct arblock *blk;
+
+	/* kept blocks are not on the back, and wait for arena_fini */
+	for (blk = ar->back; blk; blk = blk->next) {
+		if ((uint8_t *)blk + head == ptr) break;
+	}
+	if (!blk) return;
+
+	blk->freed = true;
+
+	/* as in a buffer, the back only shrinks from its end */
+	while (ar->back && ar->back->freed) {
+		blk = ar->back;
+		ar->hi = blk->prev;
+		ar->back = blk->next;
+		free(blk);
+	}
+}
+
+void
+arena_count(struct arena *ar)
+{
+	memset(ar, 0, sizeof *ar);
+
+	/* room enough that nothing is refused for want of it */
+	ar->len = SIZE_MAX / 2;
+	ar->count = true;
+}
+
+void
+arena_fini(struct arena *ar)
+{
+	ar_drop(ar->kept);
+	ar_drop(ar->back);
+	ar->kept = 0x0;
+	ar->back = 0x0;
+}
+
+void
+arena_init(struct arena *ar, void *buf, size_t len)
+{
+	size_t skip = -(uintptr_t)buf % AR_ALIGN;
+
+	memset(ar, 0, sizeof *ar);
+	if (len < skip) return;
+
+	ar->buf = (uint8_t *)buf + skip;
+	ar->len = (len - skip) / AR_ALIGN * AR_ALIGN;
+	ar->skip = skip;
+}
+
+void *
+arena_keep(struct arena *ar, size_t n, size_t siz)
+{
+	uint8_t *ret;
+	size_t ext;
+
+	if (!ar) return calloc(n, siz);
+
+	if (siz && n > (ar->len - ar->lo - ar->hi) / siz) return 0x0;
+	ext = ar_round(n * siz);
+	if (ext > ar->len - ar->lo - ar->hi) return 0x0;
+
+	if (ar->count) ret = ar_block(ar, &ar->kept, ext);
+	else ret = ar->buf + ar->lo;
+	if (!ret) return 0x0;
+
+	ar->lo += ext;
+	ar_peak(ar);
+
+	memset(ret, 0, ext);
+	return ret;
+}
+
+void *
+arena_temp(struct arena *ar, size_t n, size_t siz)
+{
+	uint8_t *head;
+	uint8_t *ret;
+	size_t ext;
+
+	if (!ar) return calloc(n, siz);
+
+	if (siz && n > (ar->len - ar->lo - ar->hi) / siz) return 0x0;
+	ext = AR_HEAD + ar_round(n * siz);
+	if (ext > ar->len - ar->lo - ar->hi) return 0x0;
+
+	if (ar->count) {
+		ret = ar_block(ar, &ar->back, ext - AR_HEAD);
+		if (!ret) return 0x0;
+	} else {
+		head = ar->buf + ar->len - ar->hi - ext;
+		memcpy(head, &ar->hi, sizeof ar->hi);
+		ret = head + AR_HEAD;
+	}
+
+	ar->hi += ext;
+	ar_peak(ar);
+
+	memset(ret, 0, ext - AR_HEAD);
+	return ret;
+}
+
+void
+arena_free(struct arena *ar, void *ptr)
+{
+	uint8_t *head;
+	size_t off;
+	size_t prev;
+
+	if (!ar) {
+		free(ptr);
+		return;
+	}
+
+	if (ar->count) {
+		ar_unblock(ar, ptr);
+		return;
+	}
+
+	/* what is kept stays for as long as the buffer */
+	off = (uintptr_t)ptr - (uintptr_t)ar->buf;
+	if (!ptr || off > ar->len || off < AR_HEAD) return;
+	if (off - AR_HEAD < ar->len - ar->hi) return;
+
+	/* found from the buffer, the head is always inside it */
+	head = ar->buf + (off - AR_HEAD);
+	memcpy(&prev, head, sizeof prev);
+	prev |= 1;
+	memcpy(head, &prev, sizeof prev);
+
+	/* the back gives up blocks from its end, as far as they are all given back */
+	while (ar->hi) {
+		memcpy(&prev, ar->buf + ar->len - ar->hi, sizeof prev);
+		if (~prev & 1) break;
+		ar->hi = prev & ~(size_t)1;
+	}
+}
+
+size_t
+arena_mark(struct arena *ar)
+{
+	return ar ? ar->lo : 0;
+}
+
+void
+arena_undo(struct arena *ar, size_t mark)
+{
+	/* what was kept since the mark is given back; the heap frees its own */
+	if (ar) ar->lo = mark;
+}
@@ -0,0 +1,205 @@
+#include <errno.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <util.h>
+#include <pat.h>
+#include <pat.ih>
+
+enum {
+	back_new,
+	back_open,
+	back_done,
+};
+
+/*
+ * each (instruction, position) pair over the span gets a byte: how far
+ * the search is with it, and how many ways, up to two, reach the end
+ */
+#define STATE(x) ((x) & 3)
+#define COUNT(x) ((x) >> 2)
+
+/* pairs on the stack, the instruction over the offset into the span */
+#define PAIR(pc, at) ((uint32_t)(pc) << 16 | (uint32_t)(at))
+
+struct backtrack {
+	struct ins  *prog;
+	char const  *str;
+	size_t       beg;
+	size_t       end;
+	size_t       wid;
+	uint8_t      map[BACK_MAX];
+	uint32_t     stk[BACK_MAX * 2 + 1];
+	size_t       top;
+};
+
+static uint8_t *back_at(struct backtrack *, uint32_t);
+static size_t   back_next(struct backtrack *, uint32_t, uint32_t[static 2]);
+static int      back_node(struct backtrack *, uint32_t);
+
+uint8_t *
+back_at(struct backtrack *bt, uint32_t pair)
+{
+	return bt->map + (pair >> 16) * bt->wid + (pair & 0xffff);
+}
+
+size_t
+back_next(struct backtrack *bt, uint32_t pair, uint32_t nx[static 2])
+{
+	size_t pc = pair >> 16;
+	size_t at = pair & 0xffff;
+	size_t pos = bt->beg + at;
+	struct ins *ip = bt->prog + pc;
+
+	switch (ip->op) {
+	case op_char:
+		if (pos == bt->end || (uint8_t)bt->str[pos] != (uint8_t)ip->arg) return 0;
+		nx[0] = PAIR(pc + 1, at + 1);
+		return 1;
+
+	case op_clss:
+		if (pos == bt->end || !ins_clss(ip, bt->str[pos])) return 0;
+		nx[0] = PAIR(pc + 1, at + 1);
+		return 1;
+
+	case op_fork:
+		nx[0] = PAIR(pc + ip->arg, at);
+		nx[1] = PAIR(pc + 1, at);
+		return 2;
+
+	case op_jump:
+		nx[0] = PAIR(pc + ip->arg, at);
+		return 1;
+
+	case op_bol:
+		if (pos) return 0;
+		/* fall through */
+	case op_mark:
+	case op_save:
+		nx[0] = PAIR(pc + 1, at);
+		return 1;
+
+	default:
+		return 0;
+	}
+}
+
+int
+back_node(struct backtrack *bt, uint32_t pair)
+{
+	struct ins *ip = bt->prog + (pair >> 16);
+	uint8_t *st = back_at(bt, pair);
+	uint32_t nx[2];
+	size_t nnx;
+	size_t cnt = 0;
+	size_t i;
+
+	switch (ip->op) {
+	case op_loop:
+	case op_next:
+	case op_eol:
+		return ENOTSUP;
+	default:
+		break;
+	}
+
+	nnx = back_next(bt, pair, nx);
+
+	/* first time round, see to whatever it goes on to */
+	if (STATE(*st) == back_new) {
+		*st = back_open;
+
+		for (i = 0; i < nnx; ++i) {
+			/* a loop that consumes nothing can go round any number of ways */
+			if (STATE(*back_at(bt, nx[i])) == back_open) return ENOTSUP;
+			if (STATE(*back_at(bt, nx[i])) == back_new) bt->stk[bt->top++] = nx[i];
+		}
+
+		return 0;
+	}
+
+	--bt->top;
+
+	if (ip->op == op_halt) cnt = bt->beg + (pair & 0xffff) == bt->end;
+	for (i = 0; i < nnx; ++i) cnt += COUNT(*back_at(bt, nx[i]));
+
+	*st = back_done | umin(cnt, 2) << 2;
+
+	return 0;
+}
+
+int
+back_match(struct pattern *pat, char const *str, size_t beg, size_t end)
+{
+	struct backtrack bt[1];
+	struct ins *prog = pat->prog;
+	size_t len = prog_len(prog);
+	size_t nmat = 0;
+	size_t pos = beg;
+	size_t pc = PROG_ENTRY;
+	uint32_t pair;
+	int err;
+
+	if (len * (end - beg + 1) > BACK_MAX) return ENOTSUP;
+
+	bt->prog = prog;
+	bt->str = str;
+	bt->beg = beg;
+	bt->end = end;
+	bt->wid = end - beg + 1;
+	bt->top = 0;
+	memset(bt->map, 0, len * bt->wid);
+
+	/* count the ways through the span, each pair searched from only once */
+	bt->stk[bt->top++] = PAIR(PROG_ENTRY, 0);
+
+	while (bt->top) {
+		pair = bt->stk[bt->top - 1];
+
+		if (STATE(*back_at(bt, pair)) == back_done) --bt->top;
+		else if ((err = back_node(bt, pair))) return err;
+	}
+
+	switch (COUNT(*back_at(bt, PAIR(PROG_ENTRY, 0)))) {
+	case 0: return PAT_ERR_NOMATCH;
+	case 1: break;
+	/* which way wins is for the vm's ordering to say */
+	default: return ENOTSUP;
+	}
+
+	/* the one way through, whose submatches go straight into the pattern */
+	for (;;) switch (prog[pc].op) {
+	case op_char:
+	case op_clss:
+		++pos;
+		++pc;
+		break;
+
+	case op_fork:
+		if (COUNT(*back_at(bt, PAIR(pc + prog[pc].arg, pos - beg)))) pc += prog[pc].arg;
+		else ++pc;
+		break;
+
+	case op_jump:
+		pc += prog[pc].arg;
+		break;
+
+	case op_mark:
+		if (one_mark(pat, &nmat, pos)) return ENOMEM;
+		++pc;
+		break;
+
+	case op_save:
+		one_save(pat, nmat, pos);
+		++pc;
+		break;
+
+	case op_bol:
+		++pc;
+		break;
+
+	default:
+		pat->nmat = nmat;
+		return 0;
+	}
+}
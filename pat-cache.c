@@ -0,0 +1,188 @@
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <set.h>
+
+#include <pat.h>
+#include <pat.ih>
+
+static int              cache_add(struct patcache *, struct patentry **, char const *);
+static void             cache_drop(struct patentry *);
+static int              cache_evict(struct patcache *, struct patentry *);
+static struct patentry *cache_find(struct patcache *, char const *);
+static void             cache_link(struct patcache *, struct patentry *);
+static void             cache_unlink(struct patcache *, struct patentry *);
+
+int
+cache_add(struct patcache *pc, struct patentry **dst, char const *src)
+{
+	struct patentry *ent;
+	size_t len = strlen(src);
+	int err = 0;
+
+	/* keys are the source, its nul, then the entry's address */
+	ent = calloc(1, sizeof *ent + len + 1 + sizeof ent);
+	if (!ent) return ENOMEM;
+
+	ent->len = len + 1 + sizeof ent;
+	memcpy(ent->key, src, len + 1);
+	memcpy(ent->key + len + 1, &ent, sizeof ent);
+
+	err = pat_compile(ent->pat, src);
+	if (err) goto fail;
+
+	err = set_add(pc->set, ent->key, ent->len);
+	if (err) {
+		pat_free(ent->pat);
+		goto fail;
+	}
+
+	ent->ref = 1;
+	cache_link(pc, ent);
+
+	*dst = ent;
+
+	while (pc->len > pc->max && !err) err = cache_evict(pc, pc->tail);
+
+	return err;
+
+fail:
+	free(ent);
+	return err;
+}
+
+void
+cache_drop(struct patentry *ent)
+{
+	if (--ent->ref) return;
+
+	pat_free(ent->pat);
+	free(ent);
+}
+
+int
+cache_evict(struct patcache *pc, struct patentry *ent)
+{
+	int err;
+
+	/* an entry the index has lost could never be found again, so say so */
+	err = set_remove(pc->set, ent->key, ent->len);
+	if (err) return err;
+
+	cache_unlink(pc, ent);
+	cache_drop(ent);
+
+	return 0;
+}
+
+struct patentry *
+cache_find(struct patcache *pc, char const *src)
+{
+	struct patentry *ret;
+	void *buf[2] = {0};
+	void **res = buf;
+	uint8_t *key;
+
+	if (set_query(&res, 2, pc->set, (void *)src, strlen(src) + 1) != 1) return 0x0;
+
+	key = buf[0];
+	memcpy(&ret, key + strlen(src) + 1, sizeof ret);
+
+	return ret;
+}
+
+void
+cache_link(struct patcache *pc, struct patentry *ent)
+{
+	ent->prev = 0x0;
+	ent->next = pc->head;
+
+	if (pc->head) pc->head->prev = ent;
+	else pc->tail = ent;
+
+	pc->head = ent;
+	++pc->len;
+}
+
+void
+cache_unlink(struct patcache *pc, struct patentry *ent)
+{
+	if (ent->prev) ent->prev->next = ent->next;
+	else pc->head = ent->next;
+
+	if (ent->next) ent->next->prev = ent->prev;
+	else pc->tail = ent->prev;
+
+	--pc->len;
+}
+
+struct patcache *
+pat_cache_alloc(size_t max)
+{
+	struct patcache *pc;
+
+	pc = calloc(1, sizeof *pc);
+	if (!pc) return 0x0;
+
+	pc->set = set_alloc();
+	if (!pc->set) {
+		free(pc);
+		return 0x0;
+	}
+
+	pc->max = max ? max : 1;
+
+	return pc;
+}
+
+void
+pat_cache_free(struct patcache *pc)
+{
+	struct patentry *ent;
+
+	if (!pc) return;
+
+	/* the index goes whole, so the entries need not leave it one by one */
+	while (pc->head) {
+		ent = pc->head;
+		cache_unlink(pc, ent);
+		cache_drop(ent);
+	}
+
+	set_free(pc->set);
+	free(pc);
+}
+
+int
+pat_cache_compile(struct patcache *pc, struct pattern *dst, char const *src)
+{
+	struct patentry *ent;
+	struct patmatch *mat;
+	int err;
+
+	if (!pc) return EFAULT;
+	if (!dst) return EFAULT;
+	if (!src) return EFAULT;
+
+	ent = cache_find(pc, src);
+
+	if (ent) {
+		cache_unlink(pc, ent);
+		cache_link(pc, ent);
+	} else {
+		err = cache_add(pc, &ent, src);
+		if (err) return err;
+	}
+
+	mat = calloc(ent->pat->msiz, sizeof *mat);
+	if (!mat) return ENOMEM;
+
+	*dst = *ent->pat;
+	dst->mat = mat;
+	dst->ent = ent;
+	++ent->ref;
+
+	return 0;
+}
@@ -1,6 +1,7 @@
 #include <errno.h>
 #include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include <pat.ih>
 #include <pat.h>
@@ -11,8 +12,10 @@
 static struct token *chld_next(struct token *, struct token *);
 
 static struct token *comp_alt(struct ins **, struct token *, struct token *);
+static struct token *comp_anc(struct ins **, struct token *, struct token *);
 static struct token *comp_lit(struct ins **, struct token *, struct token *);
 static struct token *comp_cls(struct ins **, struct token *, struct token *);
+static struct token *comp_cnt(struct ins **, struct token *, struct token *);
 static struct token *comp_reg(struct ins **, struct token *, struct token *);
 static struct token *comp_kln(struct ins **, struct token *, struct token *);
 static struct token *comp_nop(struct ins **, struct token *, struct token *);
@@ -20,8 +23,15 @@ static struct token *comp_opt(struct ins **, struct token *, struct token *);
 static struct token *comp_rep(struct ins **, struct token *, struct token *);
 static struct token *comp_sub(struct ins **, struct token *, struct token *);
 
+static struct ins *cls_add(struct ins *, uint8_t const [static 32]);
+
+static bool cnt_nested(struct token *);
+static void cnt_copy(struct ins **, struct ins *, size_t);
+
 static void marshal(struct ins *, struct token *tok);
 
+static size_t prefix_set(uint8_t [static 32], struct ins *, size_t, struct arena *);
+
 static struct token *(* const tab_comp[])(struct ins **, struct token *, struct token *) = {
 	[type_lit] = comp_lit,
 	[type_cls] = comp_cls,
@@ -32,6 +42,9 @@ static struct token *(* const tab_comp[])(struct ins **, struct token *, struct
 	[type_sub] = comp_sub,
 	[type_reg] = comp_reg,
 	[type_nop] = comp_nop,
+	[type_cnt] = comp_cnt,
+	[type_bol] = comp_anc,
+	[type_eol] = comp_anc,
 };
 
 static size_t tab_len[] = {
@@ -43,8 +56,77 @@ static size_t tab_len[] = {
 	[type_alt] = 2,
 	[type_sub] = 2,
 	[type_reg] = 6,
+	[type_bol] = 1,
+	[type_eol] = 1,
 };
 
+struct ins *
+cls_add(struct ins *tab, uint8_t const set[static 32])
+{
+	uint8_t const *at;
+
+	/* no class can be empty, so a zeroed slot is free */
+	for (;; tab += CLS_LEN) {
+		at = (void *)tab;
+		if (!memcmp(at, set, 32)) return tab;
+		if (!at[0] && !memcmp(at, at + 1, 31)) break;
+	}
+
+	memcpy(tab, set, 32);
+
+	return tab;
+}
+
+bool
+cnt_nested(struct token *tok)
+{
+	struct token *at;
+
+	for (at = tok - 1; at > tok - 1 - tok[-1].siz; --at) {
+		if (at->id == type_cnt && at->ch) return true;
+	}
+
+	return false;
+}
+
+size_t
+cnt_len(struct token *tok)
+{
+	size_t k = tok[-1].len;
+	size_t ret;
+
+	if (tok->max == REP_INF) ret = tok->min ? tok->min * k + 1 : k + 2;
+	else if (!tok->max) ret = k + 1;
+	else ret = tok->min * k + (tok->max - tok->min) * (k + 1);
+
+	/*
+	 * short repetitions are unrolled so the dfa and shift-and engines
+	 * still take them; long ones become a loop the vm counts through,
+	 * which cannot nest since a thread keeps a single counter
+	 */
+	tok->ch = false;
+	if (ret <= UNROLL_MAX || !tok->max || cnt_nested(tok)) return ret;
+
+	tok->ch = true;
+	return tok->min ? k + 2 : k + 3;
+}
+
+void
+cnt_copy(struct ins **dst, struct ins *src, size_t len)
+{
+	struct ins *at;
+	size_t i;
+
+	dst[0] -= len;
+	at = dst[0] + 1;
+	memcpy(at, src, len * sizeof *at);
+
+	/* classes stay behind the halt, so only their offsets move */
+	for (i = 0; i < len; ++i) {
+		if (at[i].op == op_clss && at[i].arg) at[i].arg += src - at;
+	}
+}
+
 struct token *
 chld_next(struct token *tok, struct token *ctx)
 {
@@ -66,38 +148,91 @@ comp_alt(struct ins **dst, struct token *tok, struct token *ctx)
 	size_t off;
 
 	if (tok == ctx) {
-		*dst[0]-- = instr(do_fork, tok->siz + 1);
+		*dst[0]-- = instr(op_fork, tok->len);
 		return tok->up;
 	}
 	if (tok < ctx) {
 		off = tok->up->len - tok->len - type_len(tok->up->id);
-		*dst[0]-- = instr(do_jump, off + 1);
+		*dst[0]-- = instr(op_jump, off + 1);
 		return tok - 1;
 	}
 
 	return chld_next(tok, ctx);
 }
 
+struct token *
+comp_anc(struct ins **dst, struct token *tok, struct token *ctx)
+{
+	*dst[0]-- = instr(tok->id == type_bol ? op_bol : op_eol);
+	return chld_next(ctx, tok);
+}
+
 struct token *
 comp_opt(struct ins **dst, struct token *tok, struct token *ctx)
 {
-	if (tok == ctx) *dst[0]-- = instr(do_fork, tok->len);
+	if (tok == ctx) *dst[0]-- = instr(op_fork, tok->len);
 	return chld_next(tok, ctx);
 }
 
 struct token *
 comp_rep(struct ins **dst, struct token *tok, struct token *ctx)
 {
-	if (tok < ctx) *dst[0]-- = instr(do_fork, -tok->len + 1);
+	if (tok < ctx) *dst[0]-- = instr(op_fork, -tok->len + 1);
 	else if (tok > ctx) return tok->up;
 	return chld_next(tok, ctx);
 }
 
+struct token *
+comp_cnt(struct ins **dst, struct token *tok, struct token *ctx)
+{
+	struct ins *body = dst[0] + 1;
+	struct ins *end;
+	size_t k = tok[-1].len;
+	size_t n;
+
+	if (tok < ctx) {
+		if (tok->ch) *dst[0]-- = instr(op_next, tok->max == REP_INF ? 0 : tok->max);
+		else if (tok->max == REP_INF) *dst[0]-- = instr(op_fork, -(int)k);
+	}
+
+	if (tok != ctx) return chld_next(tok, ctx);
+
+	if (tok->ch) {
+		*dst[0]-- = instr(op_loop, tok->min);
+		if (!tok->min) *dst[0]-- = instr(op_fork, tok->len);
+		return chld_next(tok, ctx);
+	}
+
+	/* the body compiled once is the last copy; the rest go in front */
+	if (tok->max == REP_INF) {
+		if (!tok->min) *dst[0]-- = instr(op_fork, tok->len);
+		for (n = 1; n < tok->min; ++n) cnt_copy(dst, body, k);
+		return chld_next(tok, ctx);
+	}
+
+	if (!tok->max) {
+		*dst[0]-- = instr(op_jump, tok->len);
+		return chld_next(tok, ctx);
+	}
+
+	/* every optional copy sits behind a fork to the end */
+	end = body + k;
+	for (n = tok->min; n < tok->max; ++n) {
+		if (n > tok->min) cnt_copy(dst, body, k);
+		*dst[0] = instr(op_fork, end - dst[0]);
+		--dst[0];
+	}
+
+	for (n = tok->min == tok->max; n < tok->min; ++n) cnt_copy(dst, body, k);
+
+	return chld_next(tok, ctx);
+}
+
 struct token *
 comp_sub(struct ins **dst, struct token *tok, struct token *ctx)
 {
-	if (tok == ctx) *dst[0]-- = instr(do_mark);
-	if (tok < ctx) *dst[0]-- = instr(do_save);
+	if (tok == ctx) *dst[0]-- = instr(op_mark);
+	if (tok < ctx) *dst[0]-- = instr(op_save);
 
 	return chld_next(tok, ctx);
 }
@@ -105,8 +240,8 @@ comp_sub(struct ins **dst, struct token *tok, struct token *ctx)
 struct token *
 comp_kln(struct ins **dst, struct token *tok, struct token *ctx)
 {
-	if (tok < ctx) *dst[0]-- = instr(do_fork, -tok->siz + 1);
-	if (tok == ctx) *dst[0]-- = instr(do_fork, tok->siz);
+	if (tok < ctx) *dst[0]-- = instr(op_fork, -tok->len + 2);
+	if (tok == ctx) *dst[0]-- = instr(op_fork, tok->len);
 
 	return chld_next(tok, ctx);
 }
@@ -115,15 +250,15 @@ struct token *
 comp_reg(struct ins **dst, struct token *tok, struct token *ctx)
 {
 	if (!ctx) {
-		*dst[0]-- = instr(do_halt);
-		*dst[0]-- = instr(do_save);
+		*dst[0]-- = instr(op_halt);
+		*dst[0]-- = instr(op_save);
 		return tok - 1;
 	}
 	if (tok == ctx) {
-		*dst[0]-- = instr(do_mark);
-		*dst[0]-- = instr(do_fork, -1);
-		*dst[0]-- = instr(do_clss, 0);
-		*dst[0]-- = instr(do_jump, 2);
+		*dst[0]-- = instr(op_mark);
+		*dst[0]-- = instr(op_fork, -1);
+		*dst[0]-- = instr(op_clss, 0);
+		*dst[0]-- = instr(op_jump, 2);
 		return 0x0;
 	}
 
@@ -133,14 +268,23 @@ comp_reg(struct ins **dst, struct token *tok, struct token *ctx)
 struct token *
 comp_lit(struct ins **dst, struct token *tok, struct token *ctx)
 {
-	*dst[0]-- = instr(do_char, tok->ch);
+	*dst[0]-- = instr(op_char, tok->ch);
 	return chld_next(ctx, tok);
 }
 
 struct token *
 comp_cls(struct ins **dst, struct token *tok, struct token *ctx)
 {
-	*dst[0]-- = instr(do_clss, tok->ch);
+	uint8_t dot[32];
+	struct ins *set;
+
+	memset(dot, 0xff, sizeof dot);
+	dot['\n' / 8] &= ~(1 << '\n' % 8);
+
+	set = cls_add(dst[1], tok->set ? tok->set : dot);
+	*dst[0] = instr(op_clss, set - dst[0]);
+	--dst[0];
+
 	return chld_next(ctx, tok);
 }
 
@@ -150,6 +294,184 @@ comp_nop(struct ins **dst, struct token *tok, struct token *ctx)
 	return chld_next(ctx, tok);
 }
 
+size_t
+prefix_lit(char *dst, struct ins *prog)
+{
+	struct ins *ip = prog + PROG_ENTRY;
+	size_t len = 0;
+
+	while (true) switch (ip->op) {
+	case op_char:
+		dst[len++] = ip->arg;
+		++ip;
+		break;
+	case op_jump:
+		ip += ip->arg;
+		break;
+	case op_mark:
+	case op_save:
+	case op_loop:
+	case op_bol:
+		++ip;
+		break;
+	default:
+		return len;
+	}
+}
+
+size_t
+prefix_set(uint8_t set[static 32], struct ins *prog, size_t len, struct arena *ar)
+{
+	uint8_t *seen;
+	size_t *stk;
+	size_t top = 0;
+	size_t ret = 0;
+	size_t pc;
+	size_t ch;
+	size_t n;
+
+	seen = arena_temp(ar, len, sizeof *seen);
+	stk = arena_temp(ar, len * 2 + 1, sizeof *stk);
+	if (!seen || !stk) {
+		ret = -1;
+		goto finally;
+	}
+
+	stk[top++] = PROG_ENTRY;
+
+	while (top) {
+		pc = stk[--top];
+		if (seen[pc]) continue;
+		seen[pc] = 1;
+
+		switch (prog[pc].op) {
+		case op_char:
+			ch = (uint8_t)prog[pc].arg;
+			if (set[ch / 8] & 1 << ch % 8) break;
+			set[ch / 8] |= 1 << ch % 8;
+			++ret;
+			break;
+		case op_clss:
+			/* a class that takes most bytes filters nothing */
+			for (ch = 0, n = 0; ch < 256; ++ch) n += ins_clss(prog + pc, ch);
+			if (n > 128) {
+				ret = 0;
+				goto finally;
+			}
+
+			for (ch = 0; ch < 256; ++ch) {
+				if (!ins_clss(prog + pc, ch)) continue;
+				if (set[ch / 8] & 1 << ch % 8) continue;
+				set[ch / 8] |= 1 << ch % 8;
+				++ret;
+			}
+			break;
+		case op_fork:
+			stk[top++] = pc + prog[pc].arg;
+			stk[top++] = pc + 1;
+			break;
+		case op_jump:
+			stk[top++] = pc + prog[pc].arg;
+			break;
+		case op_mark:
+		case op_save:
+		case op_loop:
+		case op_next:
+		case op_bol:
+			stk[top++] = pc + 1;
+			break;
+		default:
+			ret = 0;
+			goto finally;
+		}
+	}
+
+finally:
+	arena_free(ar, seen);
+	arena_free(ar, stk);
+	return ret;
+}
+
+size_t
+loop_len(struct ins *ip)
+{
+	size_t ret = 1;
+
+	while (ip[ret].op != op_next) ++ret;
+
+	return ret;
+}
+
+size_t
+loop_states(struct ins *ip)
+{
+	struct ins *next = ip + loop_len(ip);
+
+	/* past its minimum an endless loop's count no longer matters */
+	return next->arg ? (size_t)next->arg : ip->arg + 1UL;
+}
+
+bool
+prog_anchored(struct ins *prog)
+{
+	/* an anchored program jumps over the .-loop straight to its entry */
+	return prog[0].arg == PROG_ENTRY;
+}
+
+size_t
+prog_cls(struct ins *prog, size_t len)
+{
+	size_t end = len;
+	size_t pc;
+
+	for (pc = 0; pc < len; ++pc) {
+		if (prog[pc].op != op_clss || !prog[pc].arg) continue;
+		if (pc + prog[pc].arg + CLS_LEN > end) end = pc + prog[pc].arg + CLS_LEN;
+	}
+
+	return end - len;
+}
+
+size_t
+prog_len(struct ins *prog)
+{
+	size_t len = 0;
+
+	while (prog[len].op != op_halt) ++len;
+
+	return len + 1;
+}
+
+size_t
+prog_vis(struct ins *prog, size_t len)
+{
+	size_t ret = len;
+	size_t pc;
+
+	for (pc = 0; pc < len; ++pc) {
+		if (prog[pc].op != op_loop) continue;
+		ret += loop_len(prog + pc) * loop_states(prog + pc);
+	}
+
+	return ret;
+}
+
+bool
+prog_vm(struct ins *prog, size_t len)
+{
+	size_t pc;
+
+	if (prog_vis(prog, len) > len) return true;
+
+	/* the other engines only know a ^ that every match starts with */
+	for (pc = PROG_ENTRY; pc < len; ++pc) {
+		if (prog[pc].op == op_eol) return true;
+		if (prog[pc].op == op_bol && !prog_anchored(prog)) return true;
+	}
+
+	return false;
+}
+
 size_t
 type_len(enum type ty)
 {
@@ -157,15 +479,18 @@ type_len(enum type ty)
 }
 
 void
-marshal(struct ins *dst, struct token *tok)
+marshal(struct ins *prog, struct token *tok)
 {
 	struct token *tmp = 0x0;
 	struct token *ctx = 0x0;
+	struct ins *dst[2];
 
-	dst += tok->len - 1;
+	/* instructions are laid down back to front, classes behind the halt */
+	dst[0] = prog + tok->len - 1;
+	dst[1] = prog + tok->len;
 
 	while (tok) {
-		tmp = tab_comp[tok->id](&dst, tok, ctx);
+		tmp = tab_comp[tok->id](dst, tok, ctx);
 
 		if (!tmp) break;
 
@@ -183,12 +508,177 @@ marshal(struct ins *dst, struct token *tok)
 }
 
 int
-pat_marshal(struct pattern *pat, struct token *tok)
+pat_merge(struct ins **dst, size_t *len, struct ins **progs, size_t nprog)
+{
+	struct ins *prog;
+	size_t body = PROG_ENTRY + nprog;
+	size_t cls = 0;
+	size_t ext;
+	size_t pc;
+	size_t i;
+	size_t j;
+
+	for (i = 0; i < nprog; ++i) {
+		ext = prog_len(progs[i]);
+		body += ext - PROG_ENTRY;
+		cls += prog_cls(progs[i], ext);
+	}
+	if (body + cls > INT16_MAX) return EOVERFLOW;
+
+	prog = calloc(body + cls, sizeof *prog);
+	if (!prog) return ENOMEM;
+
+	*len = body;
+
+	prog[0] = instr(op_jump, 2);
+	prog[1] = instr(op_clss, 0);
+	prog[2] = instr(op_fork, -1);
+
+	/* fork into every body, each ending in a halt tagged with its index */
+	cls = body;
+	body = PROG_ENTRY + nprog;
+	for (i = 0; i < nprog; ++i) {
+		pc = PROG_ENTRY + i;
+		ext = prog_len(progs[i]);
+
+		if (i + 1 < nprog) prog[pc] = instr(op_fork, body - pc);
+		else prog[pc] = instr(op_jump, body - pc);
+
+		memcpy(prog + body, progs[i] + PROG_ENTRY, (ext - PROG_ENTRY) * sizeof *prog);
+
+		/* the classes all move behind the last body */
+		for (j = PROG_ENTRY; j < ext; ++j) {
+			pc = body + j - PROG_ENTRY;
+			if (prog[pc].op != op_clss || !prog[pc].arg) continue;
+			prog[pc].arg = cls + (j + prog[pc].arg - ext) - pc;
+		}
+
+		memcpy(prog + cls, progs[i] + ext, prog_cls(progs[i], ext) * sizeof *prog);
+		cls += prog_cls(progs[i], ext);
+
+		body += ext - PROG_ENTRY;
+		prog[body - 1].arg = i;
+	}
+
+	*dst = prog;
+
+	return 0;
+}
+
+int
+pat_anchor(struct pattern *pat, int flags, struct arena *ar)
+{
+	struct ins *prog = pat->prog;
+	size_t len = prog_len(prog);
+	uint8_t *seen;
+	size_t *stk;
+	size_t top = 0;
+	size_t pc;
+	bool anc = true;
+	int err = 0;
+
+	if (flags & PAT_ANCHORED) {
+		prog[0] = instr(op_jump, PROG_ENTRY);
+		return 0;
+	}
+
+	seen = arena_temp(ar, len, sizeof *seen);
+	stk = arena_temp(ar, len * 2 + 1, sizeof *stk);
+	if (!seen || !stk) {
+		err = ENOMEM;
+		goto finally;
+	}
+
+	/* anchored if every way in passes a ^ before anything else */
+	stk[top++] = PROG_ENTRY;
+
+	while (anc && top) {
+		pc = stk[--top];
+		if (seen[pc]) continue;
+		seen[pc] = 1;
+
+		switch (prog[pc].op) {
+		case op_bol:
+			break;
+		case op_fork:
+			stk[top++] = pc + prog[pc].arg;
+			stk[top++] = pc + 1;
+			break;
+		case op_jump:
+			stk[top++] = pc + prog[pc].arg;
+			break;
+		case op_mark:
+		case op_save:
+		case op_loop:
+			stk[top++] = pc + 1;
+			break;
+		default:
+			anc = false;
+		}
+	}
+
+	if (anc) prog[0] = instr(op_jump, PROG_ENTRY);
+
+finally:
+	arena_free(ar, seen);
+	arena_free(ar, stk);
+	return err;
+}
+
+int
+pat_prefix(struct pattern *pat, struct arena *ar)
 {
-	pat->prog = calloc(tok->len, sizeof *pat->prog);
+	struct prefix *pre;
+	uint8_t set[32] = {0};
+	size_t len = prog_len(pat->prog);
+	size_t nset;
+	size_t ch;
+
+	/* an anchored match has nowhere to skip to */
+	if (prog_anchored(pat->prog)) return 0;
+
+	nset = prefix_set(set, pat->prog, len, ar);
+	if (nset == -1UL) return ENOMEM;
+	if (!nset) return 0;
+
+	pre = arena_keep(ar, 1, sizeof *pre + len);
+	if (!pre) return ENOMEM;
+
+	pre->len = prefix_lit(pre->lit, pat->prog);
+	pre->nset = nset;
+	memcpy(pre->set, set, sizeof set);
+
+	/* a lone first byte behind a branch, e.g. 'a|ab' */
+	if (!pre->len && nset == 1) {
+		for (ch = 0; ~set[ch / 8] & 1 << ch % 8; ++ch) continue;
+		pre->lit[pre->len++] = ch;
+	}
+
+	pat->pre = pre;
+
+	return 0;
+}
+
+int
+pat_marshal(struct pattern *pat, struct token *tok, struct arena *ar)
+{
+	struct token *at;
+	size_t ncls = 0;
+
+	for (at = tok; at->id; --at) ncls += at->id == type_cls;
+	if (ncls && tok->len + ncls * CLS_LEN > INT16_MAX) return EOVERFLOW;
+
+	pat->prog = arena_keep(ar, tok->len + ncls * CLS_LEN, sizeof *pat->prog);
 	if (!pat->prog) return ENOMEM;
 
 	marshal(pat->prog, tok);
 
+	/* each count of a loop needs its own visits in the vm */
+	if (prog_vis(pat->prog, tok->len) > VIS_MAX) {
+		arena_free(ar, pat->prog);
+		pat->prog = 0x0;
+		return PAT_ERR_BADREP;
+	}
+
 	return 0;
 }
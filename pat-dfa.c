@@ -0,0 +1,842 @@
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <util.h>
+#include <pat.h>
+#include <pat.ih>
+
+#define DFA_SEP   0xffff
+#define DFA_SLOTS 1024
+#define DFA_MAX   (DFA_SLOTS / 2)
+
+/* the most states a forward search compiled to machine code may have */
+#define JIT_STATES 128
+
+enum {
+	st_accept = 1,
+	st_matched = 2,
+	st_dead = 4,
+	st_start = 8,
+};
+
+struct dstate {
+	struct dstate *next[256];
+	uint32_t       hash;
+	uint32_t       flags;
+	uint32_t       len;
+	uint32_t       jid;
+	uint16_t       key[];
+};
+
+struct dcache {
+	struct dstate **tab;
+	struct dstate  *init;
+	size_t          nstate;
+	size_t          nflush;
+};
+
+struct dfa {
+	struct ins     *prog;
+	size_t          len;
+	size_t          gen;
+	bool            anchored;
+	bool            bol;
+	size_t         *seen;
+	size_t         *stk;
+	uint16_t       *key;
+	uint16_t       *clo;
+	size_t         *clo_off;
+	uint16_t       *pre;
+	size_t         *pre_off;
+	uint8_t        *is_ent;
+	uint8_t        *is_live;
+	size_t          nent;
+	uint16_t       *ent;
+	struct dcache   fwd[1];
+	struct dcache   rev[1];
+	size_t          runs;
+	struct jit     *jit;
+	struct dstate **jst;
+};
+
+static bool   ins_accepts(struct ins *, uint8_t);
+static bool   ins_consumes(struct ins *);
+
+static size_t closure(struct dfa *, uint16_t *, size_t);
+static void   sort(uint16_t *, size_t);
+
+static void           cache_flush(struct dcache *);
+static int            cache_init(struct dcache *);
+static struct dstate *cache_intern(struct dcache *, uint16_t *, size_t, uint16_t);
+
+static struct dstate *fwd_init(struct dfa *);
+static struct dstate *fwd_make(struct dfa *, size_t, uint16_t);
+static struct dstate *fwd_step(struct dfa *, struct dstate *, uint8_t);
+static struct dstate *fwd_stop(struct dfa *, struct dstate *);
+
+static struct dstate *rev_init(struct dfa *);
+static struct dstate *rev_step(struct dfa *, struct dstate *, uint8_t);
+
+static struct dstate *set_init(struct dfa *);
+static struct dstate *set_step(struct dfa *, struct dstate *, uint8_t);
+static void           set_hits(struct patset *, struct dfa *, struct dstate *);
+
+static int dfa_jit(struct pattern *, struct dfa *);
+static int dfa_prepare(struct dfa *);
+
+bool
+ins_accepts(struct ins *ip, uint8_t ch)
+{
+	if (ip->op == op_char) return (uint8_t)ip->arg == ch;
+
+	return ins_clss(ip, ch);
+}
+
+bool
+ins_consumes(struct ins *ip)
+{
+	return ip->op == op_char || ip->op == op_clss;
+}
+
+size_t
+closure(struct dfa *dfa, uint16_t *dst, size_t pc)
+{
+	struct ins *ip;
+	size_t *stk = dfa->stk;
+	size_t top = 0;
+	size_t len = 0;
+
+	stk[top++] = pc;
+
+	while (top) {
+		pc = stk[--top];
+		if (dfa->seen[pc] == dfa->gen) continue;
+		dfa->seen[pc] = dfa->gen;
+
+		ip = dfa->prog + pc;
+
+		switch (ip->op) {
+		case op_jump:
+			stk[top++] = pc + ip->arg;
+			break;
+		case op_fork:
+			stk[top++] = pc + ip->arg;
+			stk[top++] = pc + 1;
+			break;
+		case op_mark:
+		case op_save:
+			stk[top++] = pc + 1;
+			break;
+		case op_bol:
+			if (dfa->bol) stk[top++] = pc + 1;
+			break;
+		default:
+			dst[len++] = pc;
+		}
+	}
+
+	return len;
+}
+
+void
+sort(uint16_t *arr, size_t len)
+{
+	size_t i;
+	size_t j;
+	uint16_t tmp;
+
+	for (i = 1; i < len; ++i) {
+		tmp = arr[i];
+		for (j = i; j && arr[j - 1] > tmp; --j) arr[j] = arr[j - 1];
+		arr[j] = tmp;
+	}
+}
+
+void
+cache_flush(struct dcache *ca)
+{
+	size_t i;
+
+	for (i = 0; i < DFA_SLOTS; ++i) {
+		free(ca->tab[i]);
+		ca->tab[i] = 0x0;
+	}
+
+	ca->init = 0x0;
+	ca->nstate = 0;
+	++ca->nflush;
+}
+
+int
+cache_init(struct dcache *ca)
+{
+	ca->tab = calloc(DFA_SLOTS, sizeof *ca->tab);
+	if (!ca->tab) return ENOMEM;
+
+	return 0;
+}
+
+struct dstate *
+cache_intern(struct dcache *ca, uint16_t *key, size_t len, uint16_t flags)
+{
+	struct dstate *st;
+	uint32_t hash = 2166136261u ^ flags;
+	size_t i;
+
+	for (i = 0; i < len; ++i) hash = (hash ^ key[i]) * 16777619u;
+
+	for (i = hash; (st = ca->tab[i % DFA_SLOTS]); ++i) {
+		if (st->hash != hash) continue;
+		if (st->flags != flags || st->len != len) continue;
+		if (!memcmp(st->key, key, len * sizeof *key)) return st;
+	}
+
+	if (ca->nstate == DFA_MAX) {
+		cache_flush(ca);
+		for (i = hash; ca->tab[i % DFA_SLOTS]; ++i) continue;
+	}
+
+	st = calloc(1, sizeof *st + len * sizeof *key);
+	if (!st) return 0x0;
+
+	st->hash = hash;
+	st->flags = flags;
+	st->len = len;
+	memcpy(st->key, key, len * sizeof *key);
+
+	ca->tab[i % DFA_SLOTS] = st;
+	++ca->nstate;
+
+	return st;
+}
+
+struct dstate *
+fwd_init(struct dfa *dfa)
+{
+	if (dfa->fwd->init) return dfa->fwd->init;
+
+	memcpy(dfa->key, dfa->ent, dfa->nent * sizeof *dfa->key);
+	dfa->key[dfa->nent] = DFA_SEP;
+
+	return dfa->fwd->init = fwd_make(dfa, dfa->nent + 1, 0);
+}
+
+struct dstate *
+fwd_make(struct dfa *dfa, size_t len, uint16_t flags)
+{
+	size_t i;
+
+	for (i = 0; i < len; ++i) {
+		if (dfa->key[i] == DFA_SEP) continue;
+		if (dfa->prog[dfa->key[i]].op != op_halt) continue;
+
+		flags |= st_accept | st_matched;
+		while (dfa->key[i] != DFA_SEP) ++i;
+		len = i + 1;
+	}
+
+	if (!len && (flags & st_matched || dfa->anchored)) flags |= st_dead;
+
+	return cache_intern(dfa->fwd, dfa->key, len, flags);
+}
+
+struct dstate *
+fwd_step(struct dfa *dfa, struct dstate *st, uint8_t ch)
+{
+	struct dstate *res;
+	uint16_t *key = dfa->key;
+	size_t beg = 0;
+	size_t len = 0;
+	size_t i;
+	size_t j;
+	size_t gen = dfa->fwd->nflush;
+	uint16_t pc;
+
+	++dfa->gen;
+
+	for (i = 0; i < st->len; ++i) {
+		pc = st->key[i];
+
+		if (pc == DFA_SEP) {
+			if (len > beg) {
+				sort(key + beg, len - beg);
+				key[len++] = DFA_SEP;
+			}
+			beg = len;
+			continue;
+		}
+
+		if (!ins_consumes(dfa->prog + pc)) continue;
+		if (!ins_accepts(dfa->prog + pc, ch)) continue;
+
+		for (j = dfa->clo_off[pc]; j < dfa->clo_off[pc + 1]; ++j) {
+			if (dfa->seen[dfa->clo[j]] == dfa->gen) continue;
+			dfa->seen[dfa->clo[j]] = dfa->gen;
+			key[len++] = dfa->clo[j];
+		}
+	}
+
+	/* an anchored program is only entered at the start */
+	if (~st->flags & st_matched && !dfa->anchored) {
+		beg = len;
+		for (j = 0; j < dfa->nent; ++j) {
+			if (dfa->seen[dfa->ent[j]] == dfa->gen) continue;
+			dfa->seen[dfa->ent[j]] = dfa->gen;
+			key[len++] = dfa->ent[j];
+		}
+		if (len > beg) key[len++] = DFA_SEP;
+	}
+
+	res = fwd_make(dfa, len, st->flags & st_matched);
+	if (!res) return 0x0;
+
+	if (gen == dfa->fwd->nflush) st->next[ch] = res;
+
+	return res;
+}
+
+struct dstate *
+fwd_stop(struct dfa *dfa, struct dstate *st)
+{
+	uint16_t flags = st->flags | st_matched;
+
+	/* the same threads, but like a matched state it takes no new starts */
+	if (!st->len) flags |= st_dead;
+
+	/* interning may flush the cache, and st with it */
+	memcpy(dfa->key, st->key, st->len * sizeof *dfa->key);
+
+	return cache_intern(dfa->fwd, dfa->key, st->len, flags);
+}
+
+struct dstate *
+rev_init(struct dfa *dfa)
+{
+	size_t len = 0;
+	size_t halt = dfa->len - 1;
+	size_t i;
+
+	if (dfa->rev->init) return dfa->rev->init;
+
+	for (i = dfa->pre_off[halt]; i < dfa->pre_off[halt + 1]; ++i) {
+		dfa->key[len++] = dfa->pre[i];
+	}
+
+	dfa->rev->init = cache_intern(dfa->rev, dfa->key, len,
+	                              dfa->is_ent[halt] ? st_start : 0);
+
+	return dfa->rev->init;
+}
+
+struct dstate *
+rev_step(struct dfa *dfa, struct dstate *st, uint8_t ch)
+{
+	struct dstate *res;
+	uint16_t flags = 0;
+	size_t gen = dfa->rev->nflush;
+	size_t len = 0;
+	size_t i;
+	size_t j;
+	uint16_t pc;
+
+	++dfa->gen;
+
+	for (i = 0; i < st->len; ++i) {
+		pc = st->key[i];
+
+		if (!ins_accepts(dfa->prog + pc, ch)) continue;
+		if (dfa->is_ent[pc]) flags |= st_start;
+
+		for (j = dfa->pre_off[pc]; j < dfa->pre_off[pc + 1]; ++j) {
+			if (dfa->seen[dfa->pre[j]] == dfa->gen) continue;
+			dfa->seen[dfa->pre[j]] = dfa->gen;
+			dfa->key[len++] = dfa->pre[j];
+		}
+	}
+
+	sort(dfa->key, len);
+	if (!len) flags |= st_dead;
+
+	res = cache_intern(dfa->rev, dfa->key, len, flags);
+	if (!res) return 0x0;
+
+	if (gen == dfa->rev->nflush) st->next[ch] = res;
+
+	return res;
+}
+
+struct dstate *
+set_init(struct dfa *dfa)
+{
+	uint16_t flags = 0;
+	size_t i;
+
+	if (dfa->fwd->init) return dfa->fwd->init;
+
+	for (i = 0; i < dfa->nent; ++i) {
+		if (dfa->prog[dfa->ent[i]].op == op_halt) flags |= st_accept;
+	}
+
+	return dfa->fwd->init = cache_intern(dfa->fwd, dfa->ent, dfa->nent, flags);
+}
+
+struct dstate *
+set_step(struct dfa *dfa, struct dstate *st, uint8_t ch)
+{
+	struct dstate *res;
+	uint16_t flags = 0;
+	size_t gen = dfa->fwd->nflush;
+	size_t len = 0;
+	size_t i;
+	size_t j;
+	uint16_t pc;
+
+	++dfa->gen;
+
+	for (i = 0; i < st->len; ++i) {
+		pc = st->key[i];
+
+		if (!ins_consumes(dfa->prog + pc)) continue;
+		if (!ins_accepts(dfa->prog + pc, ch)) continue;
+
+		for (j = dfa->clo_off[pc]; j < dfa->clo_off[pc + 1]; ++j) {
+			if (dfa->seen[dfa->clo[j]] == dfa->gen) continue;
+			dfa->seen[dfa->clo[j]] = dfa->gen;
+			dfa->key[len++] = dfa->clo[j];
+		}
+	}
+
+	for (j = 0; j < dfa->nent; ++j) {
+		if (dfa->seen[dfa->ent[j]] == dfa->gen) continue;
+		dfa->seen[dfa->ent[j]] = dfa->gen;
+		dfa->key[len++] = dfa->ent[j];
+	}
+
+	sort(dfa->key, len);
+
+	for (i = 0; i < len; ++i) {
+		if (dfa->prog[dfa->key[i]].op == op_halt) flags |= st_accept;
+	}
+
+	res = cache_intern(dfa->fwd, dfa->key, len, flags);
+	if (!res) return 0x0;
+
+	if (gen == dfa->fwd->nflush) st->next[ch] = res;
+
+	return res;
+}
+
+void
+set_hits(struct patset *set, struct dfa *dfa, struct dstate *st)
+{
+	size_t id;
+	size_t i;
+
+	for (i = 0; i < st->len; ++i) {
+		if (dfa->prog[st->key[i]].op != op_halt) continue;
+
+		id = dfa->prog[st->key[i]].arg;
+		if (set->hit[id / 8] & 1 << id % 8) continue;
+
+		set->hit[id / 8] |= 1 << id % 8;
+		set->mat[set->nmat++] = id;
+	}
+}
+
+int
+dfa_prepare(struct dfa *dfa)
+{
+	uint16_t *tmp = dfa->key;
+	size_t *cur;
+	size_t top = 0;
+	int err = 0;
+	size_t len;
+	size_t pc;
+	size_t i;
+
+	/* a ^ only holds on the way in, before anything is consumed */
+	++dfa->gen;
+	dfa->bol = true;
+	len = closure(dfa, tmp, PROG_ENTRY);
+	dfa->bol = false;
+	sort(tmp, len);
+
+	dfa->nent = len;
+	dfa->ent = malloc((len + 1) * sizeof *dfa->ent);
+	if (!dfa->ent) return ENOMEM;
+	memcpy(dfa->ent, tmp, len * sizeof *tmp);
+
+	cur = malloc(dfa->len * sizeof *cur);
+	if (!cur) return ENOMEM;
+
+	/* the .-loop is not reachable from the entry, so it never gets marked */
+	for (i = 0; i < len; ++i) {
+		dfa->is_ent[tmp[i]] = 1;
+		dfa->is_live[tmp[i]] = 1;
+		cur[top++] = tmp[i];
+	}
+
+	dfa->clo_off = calloc(dfa->len + 1, sizeof *dfa->clo_off);
+	dfa->pre_off = calloc(dfa->len + 1, sizeof *dfa->pre_off);
+	if (!dfa->clo_off || !dfa->pre_off) {
+		err = ENOMEM;
+		goto finally;
+	}
+
+	while (top) {
+		pc = cur[--top];
+		if (!ins_consumes(dfa->prog + pc)) continue;
+
+		++dfa->gen;
+		len = closure(dfa, tmp, pc + 1);
+		dfa->clo_off[pc + 1] = len;
+
+		for (i = 0; i < len; ++i) {
+			if (dfa->is_live[tmp[i]]) continue;
+			dfa->is_live[tmp[i]] = 1;
+			cur[top++] = tmp[i];
+		}
+	}
+
+	for (pc = 0; pc < dfa->len; ++pc) dfa->clo_off[pc + 1] += dfa->clo_off[pc];
+
+	dfa->clo = malloc((dfa->clo_off[dfa->len] + 1) * sizeof *dfa->clo);
+	dfa->pre = malloc((dfa->clo_off[dfa->len] + 1) * sizeof *dfa->pre);
+	if (!dfa->clo || !dfa->pre) {
+		err = ENOMEM;
+		goto finally;
+	}
+
+	for (pc = 0; pc < dfa->len; ++pc) {
+		if (dfa->clo_off[pc] == dfa->clo_off[pc + 1]) continue;
+
+		++dfa->gen;
+		len = closure(dfa, dfa->clo + dfa->clo_off[pc], pc + 1);
+		sort(dfa->clo + dfa->clo_off[pc], len);
+
+		for (i = 0; i < len; ++i) ++dfa->pre_off[dfa->clo[dfa->clo_off[pc] + i] + 1];
+	}
+
+	for (pc = 0; pc < dfa->len; ++pc) dfa->pre_off[pc + 1] += dfa->pre_off[pc];
+
+	memcpy(cur, dfa->pre_off, dfa->len * sizeof *cur);
+	for (pc = 0; pc < dfa->len; ++pc) {
+		for (i = dfa->clo_off[pc]; i < dfa->clo_off[pc + 1]; ++i) {
+			dfa->pre[cur[dfa->clo[i]]++] = pc;
+		}
+	}
+
+finally:
+	free(cur);
+	return err;
+}
+
+int
+dfa_jit(struct pattern *pat, struct dfa *dfa)
+{
+	struct dtable tab[1];
+	int err;
+
+	err = dfa_table(tab, dfa, false, JIT_STATES);
+	if (err) return err;
+
+	/* memchr beats looping in the first state, so leave that to the caller */
+	if (pat->pre && pat->pre->nset == 1) tab->flags[0] |= DT_EXIT;
+
+	err = jit_alloc(&dfa->jit, tab->next, tab->flags, tab->len);
+	if (err) {
+		dfa_table_free(tab);
+		return err;
+	}
+
+	/* the states stay, and the code gives back their places in the table */
+	dfa->jst = tab->st;
+	tab->st = 0x0;
+	dfa_table_free(tab);
+
+	return 0;
+}
+
+int
+dfa_alloc(struct dfa **dst, struct ins *prog, size_t len)
+{
+	struct dfa *dfa;
+	int err = 0;
+
+	dfa = calloc(1, sizeof *dfa);
+	if (!dfa) return ENOMEM;
+
+	dfa->prog = prog;
+	dfa->len = len;
+	dfa->anchored = prog_anchored(prog);
+
+	dfa->seen = calloc(dfa->len, sizeof *dfa->seen);
+	dfa->stk = calloc(dfa->len * 2 + 1, sizeof *dfa->stk);
+	dfa->key = calloc(dfa->len * 2 + 2, sizeof *dfa->key);
+	dfa->is_ent = calloc(dfa->len, sizeof *dfa->is_ent);
+	dfa->is_live = calloc(dfa->len, sizeof *dfa->is_live);
+
+	if (!dfa->seen || !dfa->stk || !dfa->key || !dfa->is_ent || !dfa->is_live) {
+		err = ENOMEM;
+		goto fail;
+	}
+
+	err = dfa_prepare(dfa);
+	if (err) goto fail;
+
+	err = cache_init(dfa->fwd);
+	if (err) goto fail;
+
+	err = cache_init(dfa->rev);
+	if (err) goto fail;
+
+	*dst = dfa;
+	return 0;
+
+fail:
+	dfa_free(dfa);
+	return err;
+}
+
+int
+dfa_table(struct dtable *dst, struct dfa *dfa, bool rev, size_t max)
+{
+	struct dcache *ca = rev ? dfa->rev : dfa->fwd;
+	struct dstate **st;
+	struct dstate *nx;
+	size_t gen = ca->nflush;
+	size_t n = 0;
+	size_t k;
+	size_t ch;
+	int err = 0;
+
+	memset(dst, 0, sizeof *dst);
+
+	st = calloc(max, sizeof *st);
+	dst->next = calloc(max * 256, sizeof *dst->next);
+	dst->flags = calloc(max, sizeof *dst->flags);
+	if (!st || !dst->next || !dst->flags) {
+		err = ENOMEM;
+		goto finally;
+	}
+
+	st[0] = rev ? rev_init(dfa) : fwd_init(dfa);
+	if (!st[0]) {
+		err = ENOMEM;
+		goto finally;
+	}
+	st[n++]->jid = 1;
+
+	/* every state the search can come to, with every step out of it made */
+	for (k = 0; k < n; ++k) {
+		for (ch = 0; ch < 256; ++ch) {
+			nx = st[k]->next[ch];
+			if (!nx) nx = rev ? rev_step(dfa, st[k], ch) : fwd_step(dfa, st[k], ch);
+			if (!nx) err = ENOMEM;
+
+			/* a flush takes the states found so far with it */
+			if (gen != ca->nflush) {
+				n = 0;
+				err = ENOTSUP;
+			}
+			if (err) goto finally;
+
+			if (!nx->jid) {
+				if (n == max) {
+					err = ENOTSUP;
+					goto finally;
+				}
+				st[n++] = nx;
+				nx->jid = n;
+			}
+
+			dst->next[k * 256 + ch] = nx->jid - 1;
+		}
+
+		if (st[k]->flags & st_accept) dst->flags[k] |= DT_ACCEPT;
+		if (st[k]->flags & st_start) dst->flags[k] |= DT_START;
+		if (st[k]->flags & st_dead) dst->flags[k] |= DT_EXIT;
+	}
+
+	dst->anchored = dfa->anchored;
+
+finally:
+	dst->len = n;
+	dst->st = st;
+	if (err) dfa_table_free(dst);
+
+	return err;
+}
+
+void
+dfa_table_free(struct dtable *tab)
+{
+	size_t k;
+
+	/* states left in the cache are back to having no place in a table */
+	for (k = 0; tab->st && k < tab->len; ++k) tab->st[k]->jid = 0;
+
+	free(tab->st);
+	free(tab->next);
+	free(tab->flags);
+	memset(tab, 0, sizeof *tab);
+}
+
+bool
+dfa_compiled(struct dfa *dfa)
+{
+	return dfa->jit;
+}
+
+void
+dfa_free(struct dfa *dfa)
+{
+	if (!dfa) return;
+
+	if (dfa->fwd->tab) cache_flush(dfa->fwd);
+	if (dfa->rev->tab) cache_flush(dfa->rev);
+
+	free(dfa->fwd->tab);
+	free(dfa->rev->tab);
+	free(dfa->seen);
+	free(dfa->stk);
+	free(dfa->key);
+	free(dfa->clo);
+	free(dfa->clo_off);
+	free(dfa->pre);
+	free(dfa->pre_off);
+	free(dfa->is_ent);
+	free(dfa->is_live);
+	free(dfa->ent);
+	free(dfa->jst);
+	jit_free(dfa->jit);
+	free(dfa);
+}
+
+int
+dfa_jit_alloc(struct dfa **dst, struct pattern *pat)
+{
+	struct dfa *dfa;
+	int err;
+
+	err = dfa_alloc(&dfa, pat->prog, prog_len(pat->prog));
+	if (err) return err;
+
+	err = dfa_jit(pat, dfa);
+	if (err) {
+		dfa_free(dfa);
+		return err;
+	}
+
+	*dst = dfa;
+	return 0;
+}
+
+int
+dfa_match(struct pattern *pat, struct dfa *dfa, char const *str, size_t len, size_t lim)
+{
+	struct dstate *st;
+	struct dstate *nx;
+	uint8_t const *txt = (void const *)str;
+	size_t end = -1;
+	size_t stop = umin(len, lim ? lim - 1 : 0);
+	size_t beg;
+	size_t id;
+	size_t i;
+
+	/* the interpreter does without it, so a failure only leaves it out */
+	if (pat->jit && ++dfa->runs == JIT_AFTER && !dfa->jit) dfa_jit(pat, dfa);
+
+	st = fwd_init(dfa);
+	if (!st) return ENOMEM;
+
+	if (st->flags & st_accept) end = 0;
+
+	for (i = 0; i < len && ~st->flags & st_dead; ++i) {
+		if (pat->pre && st == dfa->fwd->init) {
+			i = pre_scan(pat->pre, str, umin(len, lim), i);
+			if (i == len || i >= lim) break;
+		}
+
+		/* a step's new starts are at i + 1 */
+		if (i + 1 >= lim && ~st->flags & st_matched) {
+			st = fwd_stop(dfa, st);
+			if (!st) return ENOMEM;
+			if (st->flags & st_dead) break;
+		}
+
+		nx = st->next[txt[i]];
+		if (!nx) nx = fwd_step(dfa, st, txt[i]);
+		if (!nx) return ENOMEM;
+
+		st = nx;
+		if (st->flags & st_accept) end = i + 1;
+
+		/* compiled code goes on from here for as long as new starts may be made */
+		if (dfa->jit && st->jid) {
+			id = st->jid - 1;
+			i = jit_run(dfa->jit, txt, i + 1, stop, &id, &end) - 1;
+			st = dfa->jst[id];
+		}
+	}
+
+	if (end == -1UL) return PAT_ERR_NOMATCH;
+
+	if (dfa->anchored) {
+		pat->nmat = 1;
+		pat->mat[0] = (struct patmatch){ 0, end };
+		return 0;
+	}
+
+	st = rev_init(dfa);
+	if (!st) return ENOMEM;
+
+	beg = end;
+
+	for (i = end; i > 0 && ~st->flags & st_dead; --i) {
+		nx = st->next[txt[i - 1]];
+		if (!nx) nx = rev_step(dfa, st, txt[i - 1]);
+		if (!nx) return ENOMEM;
+
+		st = nx;
+		if (st->flags & st_start) beg = i - 1;
+	}
+
+	pat->nmat = 1;
+	pat->mat[0] = (struct patmatch){ beg, end - beg };
+
+	return 0;
+}
+
+int
+dfa_set_match(struct patset *set, struct dfa *dfa, char const *str, size_t len)
+{
+	struct dstate *st;
+	struct dstate *nx;
+	uint8_t const *txt = (void const *)str;
+	size_t i;
+
+	memset(set->hit, 0, (set->npat + 7) / 8);
+	set->nmat = 0;
+
+	st = set_init(dfa);
+	if (!st) return ENOMEM;
+
+	for (i = 0; i < len && set->nmat < set->npat; ++i) {
+		if (st->flags & st_accept) set_hits(set, dfa, st);
+
+		nx = st->next[txt[i]];
+		if (!nx) nx = set_step(dfa, st, txt[i]);
+		if (!nx) return ENOMEM;
+
+		st = nx;
+	}
+
+	if (st->flags & st_accept) set_hits(set, dfa, st);
+
+	if (!set->nmat) return PAT_ERR_NOMATCH;
+
+	return 0;
+}
@@ -0,0 +1,275 @@
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <pat.h>
+#include <pat.ih>
+
+#define DUMP_MAGIC   "pat"
+#define DUMP_VERSION 1
+#define DUMP_ORDER   0x0102
+
+/*
+ * what pat_dump writes in front of a program; the program follows as
+ * it sits in memory, so files only move between hosts of one byte order
+ */
+struct pathead {
+	char     magic[4];
+	uint16_t version;
+	uint16_t order;
+	uint32_t nsub;
+	uint32_t len;
+};
+
+/* the file holds instructions as they are, so their layout is fixed */
+typedef char dump_ins_size[sizeof (struct ins) == 4 ? 1 : -1];
+
+static int dump_check(struct ins *, size_t, size_t);
+static int dump_edge(int *, size_t *, size_t *, size_t *, size_t, int, size_t);
+
+int
+dump_edge(int *depth, size_t *loop, size_t *stk, size_t *top, size_t pc, int d, size_t lp)
+{
+	if (depth[pc] < 0) {
+		depth[pc] = d;
+		loop[pc] = lp;
+		stk[(*top)++] = pc;
+		return 0;
+	}
+
+	/* every way in has to agree on the open groups and the loop */
+	return depth[pc] == d && loop[pc] == lp ? 0 : EINVAL;
+}
+
+int
+dump_check(struct ins *prog, size_t len, size_t nsub)
+{
+	struct ins *ip;
+	size_t end = prog_len(prog);
+	size_t *loop;
+	size_t *stk;
+	size_t top = 0;
+	size_t nmark = 0;
+	size_t open = 0;
+	size_t pc;
+	size_t at;
+	int *depth;
+	int d;
+	int err = 0;
+
+	/* the .-loop in front, and a way to step over it */
+	if (prog[0].op != op_jump) return EINVAL;
+	if (prog[0].arg != 2 && prog[0].arg != PROG_ENTRY) return EINVAL;
+	if (prog[1].op != op_clss || prog[1].arg) return EINVAL;
+	if (prog[2].op != op_fork || prog[2].arg != -1) return EINVAL;
+	if (prog[PROG_ENTRY].op != op_mark) return EINVAL;
+
+	for (pc = 0; pc < end; ++pc) {
+		ip = prog + pc;
+		at = pc + ip->arg;
+
+		switch (ip->op) {
+		case op_clss:
+			/* classes sit whole behind the halt */
+			if (ip->arg < 0 || (ip->arg && (at < end || at + CLS_LEN > len))) return EINVAL;
+			break;
+		case op_jump:
+			/* only forks lead back, so a jump can never go round */
+			if (ip->arg <= 0) return EINVAL;
+			/* fall through */
+		case op_fork:
+			if (!ip->arg) return EINVAL;
+			if (pc >= PROG_ENTRY && (at < PROG_ENTRY || at >= end)) return EINVAL;
+			break;
+		case op_mark:
+			++nmark;
+			break;
+		case op_loop:
+			/* loops are laid down whole and never nest */
+			if (open) return EINVAL;
+			if (ip->arg < 0) return EINVAL;
+			open = pc;
+			break;
+		case op_next:
+			if (!open) return EINVAL;
+			/* the states a loop counts through are sized from both ends */
+			if (ip->arg < 0 || (ip->arg && ip->arg < prog[open].arg)) return EINVAL;
+			open = 0;
+			break;
+		case op_char:
+		case op_save:
+		case op_bol:
+		case op_eol:
+		case op_halt:
+			break;
+		default:
+			return EINVAL;
+		}
+	}
+
+	if (open) return EINVAL;
+
+	/* repetitions copy groups, so each has at least one mark */
+	if (nsub >= nmark) return EINVAL;
+	if (prog_vis(prog, end) > VIS_MAX) return EINVAL;
+
+	depth = malloc(end * sizeof *depth);
+	loop = calloc(end, sizeof *loop);
+	stk = calloc(end, sizeof *stk);
+	if (!depth || !loop || !stk) {
+		err = ENOMEM;
+		goto finally;
+	}
+
+	for (pc = 0; pc < end; ++pc) depth[pc] = -1;
+
+	/* groups close after they open, and loops are entered at the top */
+	err = dump_edge(depth, loop, stk, &top, PROG_ENTRY, 0, 0);
+
+	while (top && !err) {
+		pc = stk[--top];
+		ip = prog + pc;
+		d = depth[pc];
+
+		/* what runs inside a loop lies between its ends */
+		if (loop[pc] && (pc <= loop[pc] || pc > loop[pc] + loop_len(prog + loop[pc]))) {
+			err = EINVAL;
+			break;
+		}
+
+		switch (ip->op) {
+		case op_halt:
+			if (d) err = EINVAL;
+			break;
+		case op_fork:
+			err = dump_edge(depth, loop, stk, &top, pc + ip->arg, d, loop[pc]);
+			if (!err) err = dump_edge(depth, loop, stk, &top, pc + 1, d, loop[pc]);
+			break;
+		case op_jump:
+			err = dump_edge(depth, loop, stk, &top, pc + ip->arg, d, loop[pc]);
+			break;
+		case op_mark:
+			err = dump_edge(depth, loop, stk, &top, pc + 1, d + 1, loop[pc]);
+			break;
+		case op_save:
+			if (!d) err = EINVAL;
+			else err = dump_edge(depth, loop, stk, &top, pc + 1, d - 1, loop[pc]);
+			break;
+		case op_loop:
+			if (loop[pc]) err = EINVAL;
+			else err = dump_edge(depth, loop, stk, &top, pc + 1, d, pc);
+			break;
+		case op_next:
+			/* and only its own next ends it */
+			if (!loop[pc] || pc != loop[pc] + loop_len(prog + loop[pc])) err = EINVAL;
+			else err = dump_edge(depth, loop, stk, &top, loop[pc] + 1, d, loop[pc]);
+			if (!err) err = dump_edge(depth, loop, stk, &top, pc + 1, d, 0);
+			break;
+		default:
+			err = dump_edge(depth, loop, stk, &top, pc + 1, d, loop[pc]);
+		}
+	}
+
+finally:
+	free(depth);
+	free(loop);
+	free(stk);
+	return err;
+}
+
+int
+pat_dump(struct pattern *pat, void *dst, size_t *len)
+{
+	struct pathead hd = {
+		.magic   = DUMP_MAGIC,
+		.version = DUMP_VERSION,
+		.order   = DUMP_ORDER,
+	};
+	size_t end;
+	size_t siz;
+
+	if (!pat) return EFAULT;
+	if (!len) return EFAULT;
+
+	end = prog_len(pat->prog);
+	hd.nsub = pat->nsub;
+	hd.len = end + prog_cls(pat->prog, end);
+
+	siz = sizeof hd + hd.len * sizeof *pat->prog;
+
+	/* without a buffer, only say how big one has to be */
+	if (!dst) {
+		*len = siz;
+		return 0;
+	}
+
+	if (*len < siz) {
+		*len = siz;
+		return ERANGE;
+	}
+
+	memcpy(dst, &hd, sizeof hd);
+	memcpy((char *)dst + sizeof hd, pat->prog, hd.len * sizeof *pat->prog);
+	*len = siz;
+
+	return 0;
+}
+
+int
+pat_load(struct pattern *dst, void const *src, size_t len)
+{
+	struct pathead hd;
+	struct ins *prog;
+	size_t end;
+	int err;
+
+	if (!dst) return EFAULT;
+	if (!src) return EFAULT;
+
+	memset(dst, 0, sizeof *dst);
+
+	if (len < sizeof hd) return EINVAL;
+	if ((uintptr_t)src % sizeof (uint32_t)) return EINVAL;
+
+	memcpy(&hd, src, sizeof hd);
+
+	if (memcmp(hd.magic, DUMP_MAGIC, sizeof hd.magic)) return EINVAL;
+	if (hd.version != DUMP_VERSION) return ENOTSUP;
+	if (hd.order != DUMP_ORDER) return ENOTSUP;
+	if (hd.len < PROG_ENTRY + 2) return EINVAL;
+	if (hd.len > (len - sizeof hd) / sizeof *prog) return EINVAL;
+
+	/* the engines only read it, so the program runs where it lies */
+	prog = (struct ins *)((uintptr_t)src + sizeof hd);
+
+	for (end = 0; end < hd.len && prog[end].op != op_halt; ++end) continue;
+	if (end == hd.len) return EINVAL;
+
+	err = dump_check(prog, hd.len, hd.nsub);
+	if (err) return err;
+
+	dst->prog = prog;
+	dst->mapped = true;
+	dst->nsub = hd.nsub;
+	dst->msiz = hd.nsub + 1;
+
+	dst->mat = calloc(dst->msiz, sizeof *dst->mat);
+	if (!dst->mat) {
+		err = ENOMEM;
+		goto fail;
+	}
+
+	err = pat_prefix(dst, 0x0);
+	if (err) goto fail;
+
+	err = pat_plan(dst, 0x0);
+	if (err) goto fail;
+
+	return 0;
+
+fail:
+	pat_free(dst);
+	memset(dst, 0, sizeof *dst);
+	return err;
+}
@@ -3,20 +3,25 @@
 #include <stdint.h>
 #include <stdlib.h>
 
+#include <util.h>
 #include <pat.h>
 #include <pat.ih>
 
-static void ctx_fini(struct context *);
-static int  ctx_init(struct context *, struct pattern *);
-static int  ctx_next(struct context *, char const *);
+static void ctx_drop(struct context *);
 static void ctx_prune(struct context *);
+static void ctx_que(struct context *);
 static void ctx_rm(struct context *);
 static void ctx_shift(struct context *);
+static void ctx_stop(struct context *);
+static bool ctx_idle(struct context *);
 static int  ctx_step(struct context *, char const *);
+static bool ctx_visit(struct context *);
+static int  ctx_visits(struct context *, size_t);
 
 static struct thread *ctx_get(struct context *);
+static struct visit  *ctx_vis(struct context *);
 
-static int pat_exec(struct context *);
+static int pat_fini(struct context *);
 
 struct thread *
 ctx_get(struct context *ctx)
@@ -37,22 +42,82 @@ ctx_get(struct context *ctx)
 	return ret;
 }
 
+void
+ctx_drop(struct context *ctx)
+{
+	struct thread *th;
+
+	for (th = ctx->thr; th; th = th->next) thr_drop(&ctx->cfl, th);
+	for (th = ctx->que[0]; th; th = th->next) thr_drop(&ctx->cfl, th);
+	for (th = ctx->res; th; th = th->next) thr_drop(&ctx->cfl, th);
+
+	for (; ctx->snap; ctx->snap = ctx->snap->link) {
+		thr_drop(&ctx->cfl, &ctx->snap->fork);
+	}
+}
+
 void
 ctx_fini(struct context *ctx)
 {
-	thr_free(ctx->thr);
-	thr_free(ctx->que[0]);
-	thr_free(ctx->frl[0]);
-	thr_free(ctx->res);
+	ctx_drop(ctx);
+
+	if (!ctx->pm) {
+		thr_free(ctx->thr);
+		thr_free(ctx->que[0]);
+		thr_free(ctx->frl[0]);
+		thr_free(ctx->res);
+		cap_free(ctx->cfl);
+		free(ctx->vis);
+		return;
+	}
+
+	thr_join(ctx->frl, ctx->thr);
+	thr_join(ctx->frl, ctx->que[0]);
+	thr_join(ctx->frl, ctx->res);
+
+	ctx->pm->frl[0] = ctx->frl[0];
+	ctx->pm->frl[1] = ctx->frl[1];
+	ctx->pm->cfl = ctx->cfl;
+	ctx->pm->gen = ctx->gen;
 }
 
 int
 ctx_init(struct context *ctx, struct pattern *pat)
 {
+	size_t len = prog_len(pat->prog);
+	size_t nvis = prog_vis(pat->prog, len);
+	size_t base = len;
+	size_t pc;
 	int err = 0;
 
+	if (ctx->pm) {
+		ctx->frl[0] = ctx->pm->frl[0];
+		ctx->frl[1] = ctx->pm->frl[1];
+		ctx->cfl = ctx->pm->cfl;
+		ctx->gen = ctx->pm->gen;
+	}
+
+	ctx->ncap = umax(pat->nsub, 1);
+	ctx->prog = pat->prog;
+	ctx->pre = pat->pre;
+
+	err = ctx_visits(ctx, nvis);
+	if (err) return err;
+
+	/* the visits for each count of a loop go behind the program's */
+	for (pc = 0; nvis > len && pc < len; ++pc) {
+		if (pat->prog[pc].op != op_loop) continue;
+
+		ctx->vis[pc].base = base;
+		ctx->vis[pc].len = loop_len(pat->prog + pc);
+		base += ctx->vis[pc].len * loop_states(pat->prog + pc);
+	}
+
 	ctx->que[0] = ctx_get(ctx);
-	if (!ctx->que[0]) return ENOMEM;
+	if (!ctx->que[0]) {
+		err = ENOMEM;
+		goto fail;
+	}
 
 	err = thr_init(ctx->que[0], pat->prog);
 	if (err) goto fail;
@@ -64,12 +129,14 @@ fail:
 	return err;
 }
 
-int
-ctx_next(struct context *ctx, char const *txt)
+bool
+ctx_idle(struct context *ctx)
 {
-	ctx_prune(ctx); 
-	if (!ctx->thr) return 0;
-	return ctx_step(ctx, txt);
+	/* only the .-loop is left, so no match is under way */
+	if (!ctx->pre || ctx->res) return false;
+	if (!ctx->que[0] || ctx->que[0]->next) return false;
+
+	return ctx->que[0]->ip < ctx->prog + PROG_ENTRY;
 }
 
 void
@@ -85,13 +152,28 @@ ctx_prune(struct context *ctx)
 void
 ctx_rm(struct context *ctx)
 {
+	thr_drop(&ctx->cfl, ctx->thr);
 	thr_mv(ctx->frl, &ctx->thr);
 }
 
 void
 ctx_que(struct context *ctx)
 {
-	thr_mv(ctx->que, &ctx->thr);
+	struct visit *vi = ctx_vis(ctx);
+
+	if (vi->que_gen != ctx->gen) {
+		vi->que_gen = ctx->gen;
+		vi->que = ctx->thr;
+		thr_mv(ctx->que, &ctx->thr);
+		return;
+	}
+
+	if (thr_cmp(ctx->thr, vi->que) > 0) {
+		thr_drop(&ctx->cfl, vi->que);
+		thr_fork(vi->que, ctx->thr);
+	}
+
+	ctx_rm(ctx);
 }
 
 void
@@ -100,126 +182,297 @@ ctx_shift(struct context *ctx)
 	ctx->thr = ctx->que[0];
 	ctx->que[0] = 0;
 	ctx->que[1] = 0;
+	++ctx->gen;
+
+	/* fork snapshots only matter within a step */
+	for (; ctx->snap; ctx->snap = ctx->snap->link) {
+		thr_drop(&ctx->cfl, &ctx->snap->fork);
+	}
+
+	if (ctx->lim && ctx->pos >= ctx->lim) ctx_stop(ctx);
 }
 
-int
-ctx_step(struct context *ctx, char const *txt)
+void
+ctx_stop(struct context *ctx)
 {
-	return ctx->thr->ip->op(ctx, txt);
+	struct thread **at = &ctx->thr;
+
+	/* no match may start from lim on, so the .-loop goes */
+	while (*at) {
+		if (at[0]->ip < ctx->prog + PROG_ENTRY) {
+			thr_drop(&ctx->cfl, *at);
+			thr_mv(ctx->frl, at);
+		} else at = &at[0]->next;
+	}
+
+	ctx->lim = 0;
 }
 
 int
-do_char(struct context *ctx, char const *txt)
+ctx_step(struct context *ctx, char const *txt)
 {
-	char ch = ctx->thr->ip->arg;
+	struct thread *th;
+	struct thread *new;
+	size_t cnt;
 
-	if (txt && ch == *txt) {
-		++ctx->thr->ip;
-		ctx_que(ctx);
-	} else ctx_rm(ctx);
+	ctx_prune(ctx);
 
-	return ctx_next(ctx, txt);
-}
+	while ((th = ctx->thr)) switch (th->ip->op) {
+	case op_char:
+		if (txt && (char)th->ip->arg == *txt) {
+			++th->ip;
+			ctx_que(ctx);
+		} else ctx_rm(ctx);
 
-int
-do_clss(struct context *ctx, char const *txt)
-{
-	bool res;
+		ctx_prune(ctx);
+		break;
 
-	if (txt) switch (ctx->thr->ip->arg) {
-	case 0: res = true; break;
-	case '.': res = *txt != '\n' && *txt != '\0'; break;
-	}
+	case op_clss:
+		if (txt && ins_clss(th->ip, *txt)) {
+			++th->ip;
+			ctx_que(ctx);
+		} else ctx_rm(ctx);
+
+		ctx_prune(ctx);
+		break;
 
-	if (txt && res) {
-		++ctx->thr->ip;
-		ctx_que(ctx);
+	case op_fork:
+		if (!ctx_visit(ctx)) {
+			ctx_rm(ctx);
+			ctx_prune(ctx);
+			break;
+		}
+
+		new = ctx_get(ctx);
+		if (!new) return ENOMEM;
+
+		thr_fork(new, th);
+
+		new->ip += th->ip->arg;
+		++th->ip;
+
+		new->next = th;
+		ctx->thr = new;
+		break;
+
+	case op_halt:
+		if (thr_cmp(ctx->res, th) > 0) {
+			ctx_rm(ctx);
+		} else {
+			if (ctx->res) {
+				thr_drop(&ctx->cfl, ctx->res);
+				thr_mv(ctx->frl, &ctx->res);
+			}
+			ctx->thr = th->next;
+			ctx->res = th;
+			ctx->res->next = 0;
+		}
+
+		ctx_prune(ctx);
+		break;
+
+	case op_jump:
+		th->ip += th->ip->arg;
+		break;
+
+	case op_mark:
+		if (thr_mark(&ctx->cfl, th, ctx->ncap, ctx->pos)) return ENOMEM;
+
+		++th->ip;
+		break;
+
+	case op_save:
+		if (thr_save(&ctx->cfl, th, ctx->pos)) return ENOMEM;
+
+		++th->ip;
+		break;
+
+	case op_bol:
+		if (ctx->pos) {
+			ctx_rm(ctx);
+			ctx_prune(ctx);
+		} else ++th->ip;
+		break;
+
+	case op_eol:
+		if (txt) {
+			ctx_rm(ctx);
+			ctx_prune(ctx);
+		} else ++th->ip;
+		break;
+
+	case op_loop:
+		th->loop = th->ip;
+		th->cnt = 0;
+		++th->ip;
+		break;
+
+	case op_next:
+		cnt = th->cnt + 1;
+
+		if (cnt < (size_t)th->loop->arg) {
+			th->ip = th->loop + 1;
+			th->cnt = cnt;
+			break;
+		}
+
+		if (cnt == (size_t)th->ip->arg) {
+			th->loop = 0x0;
+			++th->ip;
+			break;
+		}
+
+		if (!ctx_visit(ctx)) {
+			ctx_rm(ctx);
+			ctx_prune(ctx);
+			break;
+		}
+
+		new = ctx_get(ctx);
+		if (!new) return ENOMEM;
+
+		/* go round again first; an endless loop stops counting at its minimum */
+		thr_fork(new, th);
+
+		new->ip = th->loop + 1;
+		new->cnt = th->ip->arg ? cnt : umin(cnt, th->loop->arg);
+		th->loop = 0x0;
+		++th->ip;
+
+		new->next = th;
+		ctx->thr = new;
+		break;
 	}
-	else ctx_rm(ctx);
 
-	return ctx_next(ctx, txt);
+	return 0;
 }
 
-int
-do_fork(struct context *ctx, char const *txt)
+struct visit *
+ctx_vis(struct context *ctx)
 {
-	struct thread *new;
+	struct thread *th = ctx->thr;
+	struct visit *vi;
 
-	new = ctx_get(ctx);
-	if (!new) return ENOMEM;
+	if (!th->loop) return ctx->vis + (th->ip - ctx->prog);
 
-	thr_fork(new, ctx->thr);
+	/* inside a loop every count has its own run of visits */
+	vi = ctx->vis + (th->loop - ctx->prog);
 
-	new->ip += ctx->thr->ip->arg;
-	++ctx->thr->ip;
+	return ctx->vis + vi->base + th->cnt * vi->len + (th->ip - th->loop - 1);
+}
+
+bool
+ctx_visit(struct context *ctx)
+{
+	struct visit *vi = ctx_vis(ctx);
+
+	if (vi->fork_gen != ctx->gen) {
+		vi->fork_gen = ctx->gen;
+		vi->link = ctx->snap;
+		ctx->snap = vi;
+	} else if (thr_cmp(ctx->thr, &vi->fork) <= 0) {
+		return false;
+	} else thr_drop(&ctx->cfl, &vi->fork);
 
-	new->next = ctx->thr;
-	ctx->thr = new;
+	thr_fork(&vi->fork, ctx->thr);
 
-	return ctx->thr->ip->op(ctx, txt);
+	return true;
 }
 
 int
-do_halt(struct context *ctx, char const *txt)
+ctx_visits(struct context *ctx, size_t len)
 {
-	struct thread *th;
+	struct patmatcher *pm = ctx->pm;
+	struct visit *vis;
 
-	if (thr_cmp(ctx->res, ctx->thr) > 0) {
-		ctx_rm(ctx);
-		return ctx_next(ctx, txt);
+	if (!pm) {
+		ctx->vis = calloc(len, sizeof *ctx->vis);
+		return ctx->vis ? 0 : ENOMEM;
 	}
 
-	if (ctx->res) thr_mv(ctx->frl, &ctx->res);
-	th = ctx->thr;
-	ctx->thr = ctx->thr->next;
-	ctx->res = th;
-	ctx->res->next = 0;
-	return ctx_next(ctx, txt);
-}
+	if (pm->nvis < len) {
+		vis = realloc(pm->vis, len * sizeof *vis);
+		if (!vis) return ENOMEM;
 
-int
-do_jump(struct context *ctx, char const *txt)
-{
-	ctx->thr->ip += ctx->thr->ip->arg;
-	return ctx->thr->ip->op(ctx, txt);
+		memset(vis + pm->nvis, 0, (len - pm->nvis) * sizeof *vis);
+		pm->vis = vis;
+		pm->nvis = len;
+	}
+
+	ctx->vis = pm->vis;
+
+	return 0;
 }
 
-int
-do_mark(struct context *ctx, char const *txt)
+bool
+ins_clss(struct ins *ip, uint8_t ch)
 {
-	struct thread *th = ctx->thr;
+	uint8_t const *set;
 
-	if (th->nmat < 10) {
-		th->mat[th->nmat++] = (struct patmatch){ ctx->pos, -1 };
-	}
+	if (!ip->arg) return true;
 
-	++th->ip;
-	return th->ip->op(ctx, txt);
+	set = (void const *)(ip + ip->arg);
+
+	return set[ch / 8] & 1 << ch % 8;
 }
 
-int
-do_save(struct context *ctx, char const *txt)
+size_t
+pre_scan(struct prefix *pre, char const *str, size_t len, size_t pos)
 {
-	struct thread *th = ctx->thr;
-	size_t off = th->nmat;
+	char const *at;
+	size_t ext;
+	uint8_t ch;
+
+	if (pre->nset == 1) {
+		while (pos < len) {
+			at = memchr(str + pos, pre->lit[0], len - pos);
+			if (!at) break;
 
-	while (th->mat[--off].ext != -1UL) continue;
+			/* a prefix cut short by the end may go on in the next chunk */
+			pos = at - str;
+			ext = len - pos < pre->len ? len - pos : pre->len;
+			if (!memcmp(at, pre->lit, ext)) return pos;
 
-	th->mat[off].ext = ctx->pos - th->mat[off].off;
-	++th->ip;
-	return th->ip->op(ctx, txt);
+			++pos;
+		}
+
+		return len;
+	}
+
+	for (; pos < len; ++pos) {
+		ch = str[pos];
+		if (pre->set[ch / 8] & 1 << ch % 8) return pos;
+	}
+
+	return len;
 }
 
 int
 pat_exec(struct context *ctx)
 {
-	int err;
+	size_t end = ctx->off + ctx->len;
+	size_t lim;
+	size_t pos;
+	int err = 0;
 
-	while (ctx->pos < ctx->len) {
+	while (ctx->pos < end) {
+
+		if (!ctx->que[0]) {
+			ctx->pos = end;
+			break;
+		}
+
+		if (ctx_idle(ctx)) {
+			/* a start must come before lim, so look no further */
+			lim = ctx->lim ? umin(ctx->lim - ctx->off, ctx->len) : ctx->len;
+			pos = pre_scan(ctx->pre, ctx->str, lim, ctx->pos - ctx->off);
+			ctx->pos = ctx->off + pos;
+			if (ctx->pos == end) break;
+		}
 
 		ctx_shift(ctx);	
 
-		err = ctx_next(ctx, ctx->str + ctx->pos);
+		err = ctx_step(ctx, ctx->str + (ctx->pos - ctx->off));
 		if (err) break;
 
 		++ctx->pos;
@@ -237,7 +490,7 @@ pat_fini(struct context *ctx)
 
 	ctx_shift(ctx);
 
-	err = ctx_next(ctx, 0x0);
+	err = ctx_step(ctx, 0x0);
 	if (err) return err;
 	if (!ctx->res) return PAT_ERR_NOMATCH;
 
@@ -245,24 +498,61 @@ pat_fini(struct context *ctx)
 }
 
 int
-pat_match(struct pattern *pat, struct context *ctx)
+pat_end(struct pattern *pat, struct context *ctx)
 {
 	int err;
 
-	err = ctx_init(ctx, pat);
-	if (err) return err;
-	
-	err = pat_exec(ctx);
-	if (err) goto finally;
-
 	err = pat_fini(ctx);
 	if (err) goto finally;
 
-	memcpy(pat->mat, ctx->res->mat, sizeof pat->mat);
+	if (pat->msiz < ctx->res->nmat) {
+		err = mat_grow(pat, ctx->res->nmat);
+		if (err) goto finally;
+	}
+
 	pat->nmat = ctx->res->nmat;
+	thr_read(pat->mat, ctx->res);
 
 finally:
 	ctx_fini(ctx);
 
 	return err;
 }
+
+int
+mat_grow(struct pattern *pat, size_t n)
+{
+	struct patmatch *mat;
+
+	/* matches in a caller's buffer move out to the heap to grow */
+	if (pat->placed && !pat->spilled) {
+		mat = malloc(n * sizeof *mat);
+		if (mat) memcpy(mat, pat->mat, pat->msiz * sizeof *mat);
+	} else {
+		mat = realloc(pat->mat, n * sizeof *mat);
+	}
+	if (!mat) return ENOMEM;
+
+	pat->mat = mat;
+	pat->msiz = n;
+	pat->spilled = pat->placed;
+
+	return 0;
+}
+
+int
+pat_match(struct pattern *pat, struct context *ctx)
+{
+	int err;
+
+	err = ctx_init(ctx, pat);
+	if (err) return err;
+	
+	err = pat_exec(ctx);
+	if (err) {
+		ctx_fini(ctx);
+		return err;
+	}
+
+	return pat_end(pat, ctx);
+}
@@ -0,0 +1,213 @@
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <pat.h>
+#include <pat.ih>
+
+/* the most states one search of a generated matcher may have */
+#define GEN_STATES 512
+
+/* with this many byte ranges out of a state, a switch beats a tree of ifs */
+#define GEN_SWITCH 8
+
+static void gen_comment(FILE *, char const *);
+static size_t gen_ranges(uint8_t *, uint16_t const *);
+static void gen_state(FILE *, struct dtable *, char, size_t, struct pattern *);
+static void gen_switch(FILE *, uint16_t const *, char);
+static void gen_tree(FILE *, uint16_t const *, uint8_t const *, size_t, size_t, char, size_t);
+
+void
+gen_comment(FILE *dst, char const *src)
+{
+	fputs("/* ", dst);
+
+	/* a star then a slash in the pattern would end it early */
+	for (; *src; ++src) {
+		fputc(*src, dst);
+		if (src[0] == '*' && src[1] == '/') fputc('\\', dst);
+	}
+
+	fputs(" */\n", dst);
+}
+
+size_t
+gen_ranges(uint8_t *lo, uint16_t const *next)
+{
+	size_t nlo = 0;
+	size_t ch;
+
+	/* the bytes where the next state changes */
+	for (ch = 0; ch < 256; ++ch) {
+		if (!ch || next[ch] != next[ch - 1]) lo[nlo++] = ch;
+	}
+
+	return nlo;
+}
+
+void
+gen_tree(FILE *dst, uint16_t const *next, uint8_t const *lo, size_t beg, size_t end, char dir, size_t ind)
+{
+	size_t mid = beg + (end - beg) / 2;
+
+	if (end - beg == 1) {
+		fprintf(dst, "%.*sgoto %c%u;\n", (int)ind, "\t\t\t\t\t\t\t\t\t\t", dir, (unsigned)next[lo[beg]]);
+		return;
+	}
+
+	fprintf(dst, "%.*sif (c < %u) {\n", (int)ind, "\t\t\t\t\t\t\t\t\t\t", (unsigned)lo[mid]);
+	gen_tree(dst, next, lo, beg, mid, dir, ind + 1);
+	fprintf(dst, "%.*s}\n", (int)ind, "\t\t\t\t\t\t\t\t\t\t");
+	gen_tree(dst, next, lo, mid, end, dir, ind);
+}
+
+void
+gen_switch(FILE *dst, uint16_t const *next, char dir)
+{
+	uint16_t cnt[GEN_STATES] = {0};
+	uint8_t done[256] = {0};
+	size_t top = next[0];
+	size_t nlab;
+	size_t ch;
+	size_t b;
+
+	/* the state most bytes go to is the default, the rest get cases */
+	for (ch = 0; ch < 256; ++ch) {
+		if (++cnt[next[ch]] > cnt[top]) top = next[ch];
+	}
+
+	fputs("\tswitch (c) {\n", dst);
+
+	for (ch = 0; ch < 256; ++ch) {
+		if (next[ch] == top || done[ch]) continue;
+
+		nlab = 0;
+		for (b = ch; b < 256; ++b) {
+			if (next[b] != next[ch]) continue;
+			done[b] = 1;
+			fprintf(dst, "%scase %zu:", nlab % 8 ? " " : "\t", b);
+			if (++nlab % 8 == 0) fputc('\n', dst);
+		}
+
+		fprintf(dst, "%sgoto %c%u;\n", nlab % 8 ? " " : "\t\t", dir, (unsigned)next[ch]);
+	}
+
+	fprintf(dst, "\tdefault: goto %c%zu;\n\t}\n", dir, top);
+}
+
+void
+gen_state(FILE *dst, struct dtable *tab, char dir, size_t id, struct pattern *pat)
+{
+	uint16_t const *next = tab->next + id * 256;
+	uint8_t const *flags = tab->flags + id;
+	uint8_t lo[256];
+	size_t nlo = gen_ranges(lo, next);
+	/* where every byte goes the same way, it need not be looked at */
+	char const *get = nlo > 1 ? "c = txt[%s];\n" : "%s;\n";
+
+	fprintf(dst, "%c%zu:\n", dir, id);
+
+	if (*flags & DT_ACCEPT) fputs("\tend = i;\n", dst);
+	if (*flags & DT_START) fputs("\tbeg = i;\n", dst);
+
+	if (*flags & DT_EXIT) {
+		fprintf(dst, "\tgoto %s;\n\n", dir == 'f' ? "fwd" : "rev");
+		return;
+	}
+
+	if (dir == 'r') {
+		fputs("\tif (!i) goto rev;\n\t", dst);
+		fprintf(dst, get, "--i");
+	} else if (!id && pat->pre && pat->pre->nset == 1) {
+		/* no match starts before the first byte of the prefix */
+		fprintf(dst, "\tat = memchr(txt + i, %u, len - i);\n", (unsigned)(uint8_t)pat->pre->lit[0]);
+		fputs("\tif (!at) goto fwd;\n\ti = at - txt;\n\t", dst);
+		fprintf(dst, get, "i++");
+	} else {
+		fputs("\tif (i == len) goto fwd;\n\t", dst);
+		fprintf(dst, get, "i++");
+	}
+
+	if (nlo > GEN_SWITCH) gen_switch(dst, next, dir);
+	else gen_tree(dst, next, lo, 0, nlo, dir, 1);
+
+	fputc('\n', dst);
+}
+
+int
+gen_match(FILE *dst, char const *name, char const *src)
+{
+	struct pattern pat[1];
+	struct dtable fwd[1] = {{0}};
+	struct dtable rev[1] = {{0}};
+	struct dfa *dfa = 0x0;
+	size_t len;
+	uint8_t lo[256];
+	size_t id;
+	bool look = false;
+	bool skip;
+	int err;
+
+	err = pat_compile(pat, src);
+	if (err) return err;
+
+	len = prog_len(pat->prog);
+
+	/* only what a dfa can run turns into a state machine */
+	if (prog_vm(pat->prog, len)) {
+		err = ENOTSUP;
+		goto finally;
+	}
+
+	err = dfa_alloc(&dfa, pat->prog, len);
+	if (err) goto finally;
+
+	err = dfa_table(fwd, dfa, false, GEN_STATES);
+	if (err) goto finally;
+
+	if (!fwd->anchored) err = dfa_table(rev, dfa, true, GEN_STATES);
+	if (err) goto finally;
+
+	for (id = 0; id < fwd->len; ++id) look |= gen_ranges(lo, fwd->next + id * 256) > 1;
+	for (id = 0; id < rev->len; ++id) look |= gen_ranges(lo, rev->next + id * 256) > 1;
+
+	skip = pat->pre && pat->pre->nset == 1 && ~fwd->flags[0] & DT_EXIT;
+
+	gen_comment(dst, src);
+	fprintf(dst, "int\n%s(char const *buf, size_t len, struct patmatch *mat)\n{\n", name);
+	if (look || skip) fputs("\tunsigned char const *txt = (void const *)buf;\n", dst);
+	if (skip) fputs("\tunsigned char const *at;\n", dst);
+	fputs("\tsize_t end = -1;\n", dst);
+	if (!fwd->anchored) fputs("\tsize_t beg;\n", dst);
+	fputs("\tsize_t i = 0;\n", dst);
+	if (look) fputs("\tunsigned c;\n", dst);
+	fputc('\n', dst);
+
+	/* the search for where the first match ends, as the dfa makes it */
+	fputs("\tgoto f0;\n\n", dst);
+	for (id = 0; id < fwd->len; ++id) gen_state(dst, fwd, 'f', id, pat);
+
+	fputs("fwd:\n\tif (end == (size_t)-1) return PAT_ERR_NOMATCH;\n", dst);
+
+	if (fwd->anchored) {
+		fputs("\tmat->off = 0;\n\tmat->ext = end;\n\treturn 0;\n}\n\n", dst);
+		goto finally;
+	}
+
+	/* then back from there to where it begins */
+	fputs("\tbeg = i = end;\n\tgoto r0;\n\n", dst);
+	for (id = 0; id < rev->len; ++id) gen_state(dst, rev, 'r', id, pat);
+
+	fputs("rev:\n\tmat->off = beg;\n\tmat->ext = end - beg;\n\treturn 0;\n}\n\n", dst);
+
+finally:
+	if (!err && ferror(dst)) err = EIO;
+
+	dfa_table_free(fwd);
+	dfa_table_free(rev);
+	dfa_free(dfa);
+	pat_free(pat);
+	return err;
+}
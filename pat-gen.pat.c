@@ -0,0 +1,1206 @@
+/* made by patgen from pat-gen.pat */
+#include <stddef.h>
+#include <string.h>
+
+#include <pat.h>
+
+/* hello */
+int
+gen_hello(char const *buf, size_t len, struct patmatch *mat)
+{
+	unsigned char const *txt = (void const *)buf;
+	unsigned char const *at;
+	size_t end = -1;
+	size_t beg;
+	size_t i = 0;
+	unsigned c;
+
+	goto f0;
+
+f0:
+	at = memchr(txt + i, 104, len - i);
+	if (!at) goto fwd;
+	i = at - txt;
+	c = txt[i++];
+	if (c < 104) {
+		goto f0;
+	}
+	if (c < 105) {
+		goto f1;
+	}
+	goto f0;
+
+f1:
+	if (i == len) goto fwd;
+	c = txt[i++];
+	if (c < 102) {
+		if (c < 101) {
+			goto f0;
+		}
+		goto f2;
+	}
+	if (c < 104) {
+		goto f0;
+	}
+	if (c < 105) {
+		goto f1;
+	}
+	goto f0;
+
+f2:
+	if (i == len) goto fwd;
+	c = txt[i++];
+	if (c < 105) {
+		if (c < 104) {
+			goto f0;
+		}
+		goto f1;
+	}
+	if (c < 108) {
+		goto f0;
+	}
+	if (c < 109) {
+		goto f3;
+	}
+	goto f0;
+
+f3:
+	if (i == len) goto fwd;
+	c = txt[i++];
+	if (c < 105) {
+		if (c < 104) {
+			goto f0;
+		}
+		goto f1;
+	}
+	if (c < 108) {
+		goto f0;
+	}
+	if (c < 109) {
+		goto f4;
+	}
+	goto f0;
+
+f4:
+	if (i == len) goto fwd;
+	c = txt[i++];
+	if (c < 105) {
+		if (c < 104) {
+			goto f0;
+		}
+		goto f1;
+	}
+	if (c < 111) {
+		goto f0;
+	}
+	if (c < 112) {
+		goto f5;
+	}
+	goto f0;
+
+f5:
+	end = i;
+	if (i == len) goto fwd;
+	i++;
+	goto f6;
+
+f6:
+	goto fwd;
+
+fwd:
+	if (end == (size_t)-1) return PAT_ERR_NOMATCH;
+	beg = i = end;
+	goto r0;
+
+r0:
+	if (!i) goto rev;
+	c = txt[--i];
+	if (c < 111) {
+		goto r1;
+	}
+	if (c < 112) {
+		goto r2;
+	}
+	goto r1;
+
+r1:
+	goto rev;
+
+r2:
+	if (!i) goto rev;
+	c = txt[--i];
+	if (c < 108) {
+		goto r1;
+	}
+	if (c < 109) {
+		goto r3;
+	}
+	goto r1;
+
+r3:
+	if (!i) goto rev;
+	c = txt[--i];
+	if (c < 108) {
+		goto r1;
+	}
+	if (c < 109) {
+		goto r4;
+	}
+	goto r1;
+
+r4:
+	if (!i) goto rev;
+	c = txt[--i];
+	if (c < 101) {
+		goto r1;
+	}
+	if (c < 102) {
+		goto r5;
+	}
+	goto r1;
+
+r5:
+	if (!i) goto rev;
+	c = txt[--i];
+	if (c < 104) {
+		goto r1;
+	}
+	if (c < 105) {
+		goto r6;
+	}
+	goto r1;
+
+r6:
+	beg = i;
+	goto rev;
+
+rev:
+	mat->off = beg;
+	mat->ext = end - beg;
+	return 0;
+}
+
+/* [a-z]+@[a-z]+\.com */
+int
+gen_mail(char const *buf, size_t len, struct patmatch *mat)
+{
+	unsigned char const *txt = (void const *)buf;
+	size_t end = -1;
+	size_t beg;
+	size_t i = 0;
+	unsigned c;
+
+	goto f0;
+
+f0:
+	if (i == len) goto fwd;
+	c = txt[i++];
+	if (c < 97) {
+		goto f0;
+	}
+	if (c < 123) {
+		goto f1;
+	}
+	goto f0;
+
+f1:
+	if (i == len) goto fwd;
+	c = txt[i++];
+	if (c < 65) {
+		if (c < 64) {
+			goto f0;
+		}
+		goto f2;
+	}
+	if (c < 97) {
+		goto f0;
+	}
+	if (c < 123) {
+		goto f1;
+	}
+	goto f0;
+
+f2:
+	if (i == len) goto fwd;
+	c = txt[i++];
+	if (c < 97) {
+		goto f0;
+	}
+	if (c < 123) {
+		goto f3;
+	}
+	goto f0;
+
+f3:
+	if (i == len) goto fwd;
+	c = txt[i++];
+	if (c < 64) {
+		if (c < 46) {
+			goto f0;
+		}
+		if (c < 47) {
+			goto f4;
+		}
+		goto f0;
+	}
+	if (c < 97) {
+		if (c < 65) {
+			goto f2;
+		}
+		goto f0;
+	}
+	if (c < 123) {
+		goto f3;
+	}
+	goto f0;
+
+f4:
+	if (i == len) goto fwd;
+	c = txt[i++];
+	if (c < 99) {
+		if (c < 97) {
+			goto f0;
+		}
+		goto f1;
+	}
+	if (c < 100) {
+		goto f5;
+	}
+	if (c < 123) {
+		goto f1;
+	}
+	goto f0;
+
+f5:
+	if (i == len) goto fwd;
+	c = txt[i++];
+	if (c < 97) {
+		if (c < 64) {
+			goto f0;
+		}
+		if (c < 65) {
+			goto f2;
+		}
+		goto f0;
+	}
+	if (c < 112) {
+		if (c < 111) {
+			goto f1;
+		}
+		goto f6;
+	}
+	if (c < 123) {
+		goto f1;
+	}
+	goto f0;
+
+f6:
+	if (i == len) goto fwd;
+	c = txt[i++];
+	if (c < 97) {
+		if (c < 64) {
+			goto f0;
+		}
+		if (c < 65) {
+			goto f2;
+		}
+		goto f0;
+	}
+	if (c < 110) {
+		if (c < 109) {
+			goto f1;
+		}
+		goto f7;
+	}
+	if (c < 123) {
+		goto f1;
+	}
+	goto f0;
+
+f7:
+	end = i;
+	if (i == len) goto fwd;
+	i++;
+	goto f8;
+
+f8:
+	goto fwd;
+
+fwd:
+	if (end == (size_t)-1) return PAT_ERR_NOMATCH;
+	beg = i = end;
+	goto r0;
+
+r0:
+	if (!i) goto rev;
+	c = txt[--i];
+	if (c < 109) {
+		goto r1;
+	}
+	if (c < 110) {
+		goto r2;
+	}
+	goto r1;
+
+r1:
+	goto rev;
+
+r2:
+	if (!i) goto rev;
+	c = txt[--i];
+	if (c < 111) {
+		goto r1;
+	}
+	if (c < 112) {
+		goto r3;
+	}
+	goto r1;
+
+r3:
+	if (!i) goto rev;
+	c = txt[--i];
+	if (c < 99) {
+		goto r1;
+	}
+	if (c < 100) {
+		goto r4;
+	}
+	goto r1;
+
+r4:
+	if (!i) goto rev;
+	c = txt[--i];
+	if (c < 46) {
+		goto r1;
+	}
+	if (c < 47) {
+		goto r5;
+	}
+	goto r1;
+
+r5:
+	if (!i) goto rev;
+	c = txt[--i];
+	if (c < 97) {
+		goto r1;
+	}
+	if (c < 123) {
+		goto r6;
+	}
+	goto r1;
+
+r6:
+	if (!i) goto rev;
+	c = txt[--i];
+	if (c < 65) {
+		if (c < 64) {
+			goto r1;
+		}
+		goto r7;
+	}
+	if (c < 97) {
+		goto r1;
+	}
+	if (c < 123) {
+		goto r6;
+	}
+	goto r1;
+
+r7:
+	if (!i) goto rev;
+	c = txt[--i];
+	if (c < 97) {
+		goto r1;
+	}
+	if (c < 123) {
+		goto r8;
+	}
+	goto r1;
+
+r8:
+	beg = i;
+	if (!i) goto rev;
+	c = txt[--i];
+	if (c < 97) {
+		goto r1;
+	}
+	if (c < 123) {
+		goto r8;
+	}
+	goto r1;
+
+rev:
+	mat->off = beg;
+	mat->ext = end - beg;
+	return 0;
+}
+
+/* ^(GET|POST) (/[a-z.]*) */
+int
+gen_http(char const *buf, size_t len, struct patmatch *mat)
+{
+	unsigned char const *txt = (void const *)buf;
+	size_t end = -1;
+	size_t i = 0;
+	unsigned c;
+
+	goto f0;
+
+f0:
+	if (i == len) goto fwd;
+	c = txt[i++];
+	if (c < 72) {
+		if (c < 71) {
+			goto f1;
+		}
+		goto f2;
+	}
+	if (c < 80) {
+		goto f1;
+	}
+	if (c < 81) {
+		goto f3;
+	}
+	goto f1;
+
+f1:
+	goto fwd;
+
+f2:
+	if (i == len) goto fwd;
+	c = txt[i++];
+	if (c < 69) {
+		goto f1;
+	}
+	if (c < 70) {
+		goto f4;
+	}
+	goto f1;
+
+f3:
+	if (i == len) goto fwd;
+	c = txt[i++];
+	if (c < 79) {
+		goto f1;
+	}
+	if (c < 80) {
+		goto f5;
+	}
+	goto f1;
+
+f4:
+	if (i == len) goto fwd;
+	c = txt[i++];
+	if (c < 84) {
+		goto f1;
+	}
+	if (c < 85) {
+		goto f6;
+	}
+	goto f1;
+
+f5:
+	if (i == len) goto fwd;
+	c = txt[i++];
+	if (c < 83) {
+		goto f1;
+	}
+	if (c < 84) {
+		goto f7;
+	}
+	goto f1;
+
+f6:
+	if (i == len) goto fwd;
+	c = txt[i++];
+	if (c < 32) {
+		goto f1;
+	}
+	if (c < 33) {
+		goto f8;
+	}
+	goto f1;
+
+f7:
+	if (i == len) goto fwd;
+	c = txt[i++];
+	if (c < 84) {
+		goto f1;
+	}
+	if (c < 85) {
+		goto f6;
+	}
+	goto f1;
+
+f8:
+	if (i == len) goto fwd;
+	c = txt[i++];
+	if (c < 47) {
+		goto f1;
+	}
+	if (c < 48) {
+		goto f9;
+	}
+	goto f1;
+
+f9:
+	end = i;
+	if (i == len) goto fwd;
+	c = txt[i++];
+	if (c < 47) {
+		if (c < 46) {
+			goto f10;
+		}
+		goto f9;
+	}
+	if (c < 97) {
+		goto f10;
+	}
+	if (c < 123) {
+		goto f9;
+	}
+	goto f10;
+
+f10:
+	goto fwd;
+
+fwd:
+	if (end == (size_t)-1) return PAT_ERR_NOMATCH;
+	mat->off = 0;
+	mat->ext = end;
+	return 0;
+}
+
+/* (a|ab)(c|bcd)(d*) */
+int
+gen_alt(char const *buf, size_t len, struct patmatch *mat)
+{
+	unsigned char const *txt = (void const *)buf;
+	unsigned char const *at;
+	size_t end = -1;
+	size_t beg;
+	size_t i = 0;
+	unsigned c;
+
+	goto f0;
+
+f0:
+	at = memchr(txt + i, 97, len - i);
+	if (!at) goto fwd;
+	i = at - txt;
+	c = txt[i++];
+	if (c < 97) {
+		goto f0;
+	}
+	if (c < 98) {
+		goto f1;
+	}
+	goto f0;
+
+f1:
+	if (i == len) goto fwd;
+	c = txt[i++];
+	if (c < 98) {
+		if (c < 97) {
+			goto f0;
+		}
+		goto f1;
+	}
+	if (c < 99) {
+		goto f2;
+	}
+	if (c < 100) {
+		goto f3;
+	}
+	goto f0;
+
+f2:
+	if (i == len) goto fwd;
+	c = txt[i++];
+	if (c < 98) {
+		if (c < 97) {
+			goto f0;
+		}
+		goto f1;
+	}
+	if (c < 99) {
+		goto f4;
+	}
+	if (c < 100) {
+		goto f5;
+	}
+	goto f0;
+
+f3:
+	end = i;
+	if (i == len) goto fwd;
+	c = txt[i++];
+	if (c < 100) {
+		goto f6;
+	}
+	if (c < 101) {
+		goto f3;
+	}
+	goto f6;
+
+f4:
+	if (i == len) goto fwd;
+	c = txt[i++];
+	if (c < 98) {
+		if (c < 97) {
+			goto f0;
+		}
+		goto f1;
+	}
+	if (c < 99) {
+		goto f0;
+	}
+	if (c < 100) {
+		goto f7;
+	}
+	goto f0;
+
+f5:
+	end = i;
+	if (i == len) goto fwd;
+	c = txt[i++];
+	if (c < 100) {
+		goto f6;
+	}
+	if (c < 101) {
+		goto f3;
+	}
+	goto f6;
+
+f6:
+	goto fwd;
+
+f7:
+	if (i == len) goto fwd;
+	c = txt[i++];
+	if (c < 98) {
+		if (c < 97) {
+			goto f0;
+		}
+		goto f1;
+	}
+	if (c < 100) {
+		goto f0;
+	}
+	if (c < 101) {
+		goto f3;
+	}
+	goto f0;
+
+fwd:
+	if (end == (size_t)-1) return PAT_ERR_NOMATCH;
+	beg = i = end;
+	goto r0;
+
+r0:
+	if (!i) goto rev;
+	c = txt[--i];
+	if (c < 100) {
+		if (c < 99) {
+			goto r1;
+		}
+		goto r2;
+	}
+	if (c < 101) {
+		goto r3;
+	}
+	goto r1;
+
+r1:
+	goto rev;
+
+r2:
+	if (!i) goto rev;
+	c = txt[--i];
+	if (c < 98) {
+		if (c < 97) {
+			goto r1;
+		}
+		goto r4;
+	}
+	if (c < 99) {
+		goto r5;
+	}
+	goto r1;
+
+r3:
+	if (!i) goto rev;
+	c = txt[--i];
+	if (c < 100) {
+		if (c < 99) {
+			goto r1;
+		}
+		goto r6;
+	}
+	if (c < 101) {
+		goto r3;
+	}
+	goto r1;
+
+r4:
+	beg = i;
+	goto rev;
+
+r5:
+	if (!i) goto rev;
+	c = txt[--i];
+	if (c < 97) {
+		goto r1;
+	}
+	if (c < 98) {
+		goto r4;
+	}
+	goto r1;
+
+r6:
+	if (!i) goto rev;
+	c = txt[--i];
+	if (c < 98) {
+		if (c < 97) {
+			goto r1;
+		}
+		goto r4;
+	}
+	if (c < 99) {
+		goto r7;
+	}
+	goto r1;
+
+r7:
+	if (!i) goto rev;
+	c = txt[--i];
+	if (c < 98) {
+		if (c < 97) {
+			goto r1;
+		}
+		goto r4;
+	}
+	if (c < 99) {
+		goto r5;
+	}
+	goto r1;
+
+rev:
+	mat->off = beg;
+	mat->ext = end - beg;
+	return 0;
+}
+
+/* x[0-9]{2,4}y */
+int
+gen_class(char const *buf, size_t len, struct patmatch *mat)
+{
+	unsigned char const *txt = (void const *)buf;
+	unsigned char const *at;
+	size_t end = -1;
+	size_t beg;
+	size_t i = 0;
+	unsigned c;
+
+	goto f0;
+
+f0:
+	at = memchr(txt + i, 120, len - i);
+	if (!at) goto fwd;
+	i = at - txt;
+	c = txt[i++];
+	if (c < 120) {
+		goto f0;
+	}
+	if (c < 121) {
+		goto f1;
+	}
+	goto f0;
+
+f1:
+	if (i == len) goto fwd;
+	c = txt[i++];
+	if (c < 58) {
+		if (c < 48) {
+			goto f0;
+		}
+		goto f2;
+	}
+	if (c < 120) {
+		goto f0;
+	}
+	if (c < 121) {
+		goto f1;
+	}
+	goto f0;
+
+f2:
+	if (i == len) goto fwd;
+	c = txt[i++];
+	if (c < 58) {
+		if (c < 48) {
+			goto f0;
+		}
+		goto f3;
+	}
+	if (c < 120) {
+		goto f0;
+	}
+	if (c < 121) {
+		goto f1;
+	}
+	goto f0;
+
+f3:
+	if (i == len) goto fwd;
+	c = txt[i++];
+	if (c < 120) {
+		if (c < 48) {
+			goto f0;
+		}
+		if (c < 58) {
+			goto f4;
+		}
+		goto f0;
+	}
+	if (c < 121) {
+		goto f1;
+	}
+	if (c < 122) {
+		goto f5;
+	}
+	goto f0;
+
+f4:
+	if (i == len) goto fwd;
+	c = txt[i++];
+	if (c < 120) {
+		if (c < 48) {
+			goto f0;
+		}
+		if (c < 58) {
+			goto f6;
+		}
+		goto f0;
+	}
+	if (c < 121) {
+		goto f1;
+	}
+	if (c < 122) {
+		goto f5;
+	}
+	goto f0;
+
+f5:
+	end = i;
+	if (i == len) goto fwd;
+	i++;
+	goto f7;
+
+f6:
+	if (i == len) goto fwd;
+	c = txt[i++];
+	if (c < 121) {
+		if (c < 120) {
+			goto f0;
+		}
+		goto f1;
+	}
+	if (c < 122) {
+		goto f5;
+	}
+	goto f0;
+
+f7:
+	goto fwd;
+
+fwd:
+	if (end == (size_t)-1) return PAT_ERR_NOMATCH;
+	beg = i = end;
+	goto r0;
+
+r0:
+	if (!i) goto rev;
+	c = txt[--i];
+	if (c < 121) {
+		goto r1;
+	}
+	if (c < 122) {
+		goto r2;
+	}
+	goto r1;
+
+r1:
+	goto rev;
+
+r2:
+	if (!i) goto rev;
+	c = txt[--i];
+	if (c < 48) {
+		goto r1;
+	}
+	if (c < 58) {
+		goto r3;
+	}
+	goto r1;
+
+r3:
+	if (!i) goto rev;
+	c = txt[--i];
+	if (c < 48) {
+		goto r1;
+	}
+	if (c < 58) {
+		goto r4;
+	}
+	goto r1;
+
+r4:
+	if (!i) goto rev;
+	c = txt[--i];
+	if (c < 58) {
+		if (c < 48) {
+			goto r1;
+		}
+		goto r5;
+	}
+	if (c < 120) {
+		goto r1;
+	}
+	if (c < 121) {
+		goto r6;
+	}
+	goto r1;
+
+r5:
+	if (!i) goto rev;
+	c = txt[--i];
+	if (c < 58) {
+		if (c < 48) {
+			goto r1;
+		}
+		goto r7;
+	}
+	if (c < 120) {
+		goto r1;
+	}
+	if (c < 121) {
+		goto r6;
+	}
+	goto r1;
+
+r6:
+	beg = i;
+	goto rev;
+
+r7:
+	if (!i) goto rev;
+	c = txt[--i];
+	if (c < 120) {
+		goto r1;
+	}
+	if (c < 121) {
+		goto r6;
+	}
+	goto r1;
+
+rev:
+	mat->off = beg;
+	mat->ext = end - beg;
+	return 0;
+}
+
+/* a.*b */
+int
+gen_any(char const *buf, size_t len, struct patmatch *mat)
+{
+	unsigned char const *txt = (void const *)buf;
+	unsigned char const *at;
+	size_t end = -1;
+	size_t beg;
+	size_t i = 0;
+	unsigned c;
+
+	goto f0;
+
+f0:
+	at = memchr(txt + i, 97, len - i);
+	if (!at) goto fwd;
+	i = at - txt;
+	c = txt[i++];
+	if (c < 97) {
+		goto f0;
+	}
+	if (c < 98) {
+		goto f1;
+	}
+	goto f0;
+
+f1:
+	if (i == len) goto fwd;
+	c = txt[i++];
+	if (c < 11) {
+		if (c < 10) {
+			goto f1;
+		}
+		goto f0;
+	}
+	if (c < 98) {
+		goto f1;
+	}
+	if (c < 99) {
+		goto f2;
+	}
+	goto f1;
+
+f2:
+	end = i;
+	if (i == len) goto fwd;
+	c = txt[i++];
+	if (c < 11) {
+		if (c < 10) {
+			goto f3;
+		}
+		goto f4;
+	}
+	if (c < 98) {
+		goto f3;
+	}
+	if (c < 99) {
+		goto f2;
+	}
+	goto f3;
+
+f3:
+	if (i == len) goto fwd;
+	c = txt[i++];
+	if (c < 11) {
+		if (c < 10) {
+			goto f3;
+		}
+		goto f4;
+	}
+	if (c < 98) {
+		goto f3;
+	}
+	if (c < 99) {
+		goto f2;
+	}
+	goto f3;
+
+f4:
+	goto fwd;
+
+fwd:
+	if (end == (size_t)-1) return PAT_ERR_NOMATCH;
+	beg = i = end;
+	goto r0;
+
+r0:
+	if (!i) goto rev;
+	c = txt[--i];
+	if (c < 98) {
+		goto r1;
+	}
+	if (c < 99) {
+		goto r2;
+	}
+	goto r1;
+
+r1:
+	goto rev;
+
+r2:
+	if (!i) goto rev;
+	c = txt[--i];
+	if (c < 11) {
+		if (c < 10) {
+			goto r2;
+		}
+		goto r1;
+	}
+	if (c < 97) {
+		goto r2;
+	}
+	if (c < 98) {
+		goto r3;
+	}
+	goto r2;
+
+r3:
+	beg = i;
+	if (!i) goto rev;
+	c = txt[--i];
+	if (c < 11) {
+		if (c < 10) {
+			goto r2;
+		}
+		goto r1;
+	}
+	if (c < 97) {
+		goto r2;
+	}
+	if (c < 98) {
+		goto r3;
+	}
+	goto r2;
+
+rev:
+	mat->off = beg;
+	mat->ext = end - beg;
+	return 0;
+}
+
+/* x* */
+int
+gen_empty(char const *buf, size_t len, struct patmatch *mat)
+{
+	unsigned char const *txt = (void const *)buf;
+	size_t end = -1;
+	size_t beg;
+	size_t i = 0;
+	unsigned c;
+
+	goto f0;
+
+f0:
+	end = i;
+	if (i == len) goto fwd;
+	c = txt[i++];
+	if (c < 120) {
+		goto f1;
+	}
+	if (c < 121) {
+		goto f0;
+	}
+	goto f1;
+
+f1:
+	goto fwd;
+
+fwd:
+	if (end == (size_t)-1) return PAT_ERR_NOMATCH;
+	beg = i = end;
+	goto r0;
+
+r0:
+	beg = i;
+	if (!i) goto rev;
+	c = txt[--i];
+	if (c < 120) {
+		goto r1;
+	}
+	if (c < 121) {
+		goto r0;
+	}
+	goto r1;
+
+r1:
+	goto rev;
+
+rev:
+	mat->off = beg;
+	mat->ext = end - beg;
+	return 0;
+}
+
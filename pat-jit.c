@@ -0,0 +1,259 @@
+/* MAP_ANONYMOUS is not in the POSIX the rest is built against */
+#define _DEFAULT_SOURCE
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#include <pat.h>
+#include <pat.ih>
+
+/*
+ * each state becomes a block of x86-64 that reads a byte and picks the
+ * next block by a search over the byte ranges leading out of it:
+ *
+ *	ent:  mov r8, [rcx + 8]      the end so far
+ *	      jmp run
+ *	arr:  mov r8, rsi            an accepting state ends a match here
+ *	run:  cmp rsi, rdx           a state left to the caller has no run
+ *	      jae out
+ *	      movzx eax, [rdi + rsi]
+ *	      add rsi, 1
+ *	      cmp al, lo / jae ...   down to a jmp to the next state's arr
+ *	out:  mov [rcx], state
+ *	      mov [rcx + 8], r8
+ *	      mov rax, rsi
+ *	      ret
+ *
+ * so each ent can be called as a function of the text, the position,
+ * where to stop and an array holding the state and the end so far
+ */
+
+struct jit {
+	uint8_t *code;
+	size_t   siz;
+	size_t   nstate;
+	size_t  *ent;
+};
+
+typedef size_t jit_fn(uint8_t const *, size_t, size_t, size_t *);
+
+#if defined(__x86_64__)
+
+struct emit {
+	uint8_t *buf;
+	size_t   len;
+	size_t  *arr;
+};
+
+static void put(struct emit *, char const *, size_t);
+static void put_rel(struct emit *, size_t);
+static void put_u32(struct emit *, uint32_t);
+static void patch(struct emit *, size_t);
+static void tree(struct emit *, uint16_t const *, uint8_t const *, size_t, size_t);
+static void block(struct emit *, uint16_t const *, uint8_t const *, size_t, uint8_t *);
+static void program(struct emit *, uint16_t const *, uint8_t const *, size_t, size_t *);
+
+void
+put(struct emit *em, char const *ins, size_t len)
+{
+	if (em->buf) memcpy(em->buf + em->len, ins, len);
+	em->len += len;
+}
+
+void
+put_u32(struct emit *em, uint32_t u)
+{
+	char le[4] = { u, u >> 8, u >> 16, u >> 24 };
+
+	put(em, le, sizeof le);
+}
+
+void
+put_rel(struct emit *em, size_t to)
+{
+	/* relative to the end of the displacement */
+	put_u32(em, (uint32_t)(to - (em->len + 4)));
+}
+
+void
+patch(struct emit *em, size_t at)
+{
+	size_t len = em->len;
+
+	/* a forward jump, once where it goes is known */
+	em->len = at;
+	put_rel(em, len);
+	em->len = len;
+}
+
+void
+tree(struct emit *em, uint16_t const *next, uint8_t const *lo, size_t beg, size_t end)
+{
+	size_t mid = beg + (end - beg) / 2;
+	size_t at;
+
+	if (end - beg == 1) {
+		put(em, "\xe9", 1);
+		put_rel(em, em->arr[next[lo[beg]]]);
+		return;
+	}
+
+	/* cmp al, lo; jae to the upper half */
+	put(em, "\x3c", 1);
+	put(em, (char const *)lo + mid, 1);
+	put(em, "\x0f\x83", 2);
+	at = em->len;
+	put_u32(em, 0);
+
+	tree(em, next, lo, beg, mid);
+	patch(em, at);
+	tree(em, next, lo, mid, end);
+}
+
+void
+block(struct emit *em, uint16_t const *next, uint8_t const *flags, size_t id, uint8_t *lo)
+{
+	size_t nlo = 0;
+	size_t to;
+	size_t ch;
+
+	/* ent; a state left to the caller goes straight out */
+	put(em, "\x4c\x8b\x41\x08", 4);
+	put(em, "\xe9", 1);
+	to = em->len;
+	put_u32(em, 0);
+
+	/* arr */
+	if (flags[id] & DT_ACCEPT) put(em, "\x49\x89\xf0", 3);
+
+	if (~flags[id] & DT_EXIT) {
+		/* run */
+		patch(em, to);
+		put(em, "\x48\x39\xd6", 3);
+		put(em, "\x0f\x83", 2);
+		to = em->len;
+		put_u32(em, 0);
+		put(em, "\x0f\xb6\x04\x37", 4);
+		put(em, "\x48\x83\xc6\x01", 4);
+
+		/* the bytes where the next state changes */
+		for (ch = 0; ch < 256; ++ch) {
+			if (!ch || next[ch] != next[ch - 1]) lo[nlo++] = ch;
+		}
+		tree(em, next, lo, 0, nlo);
+	}
+
+	/* out */
+	patch(em, to);
+	put(em, "\x48\xc7\x01", 3);
+	put_u32(em, id);
+	put(em, "\x4c\x89\x41\x08", 4);
+	put(em, "\x48\x89\xf0", 3);
+	put(em, "\xc3", 1);
+}
+
+void
+program(struct emit *em, uint16_t const *next, uint8_t const *flags, size_t nstate, size_t *ent)
+{
+	uint8_t lo[256];
+	size_t id;
+
+	for (id = 0; id < nstate; ++id) {
+		ent[id] = em->len;
+		/* ent is two instructions, nine bytes, ahead of arr */
+		em->arr[id] = em->len + 9;
+		block(em, next + id * 256, flags, id, lo);
+	}
+}
+
+int
+jit_alloc(struct jit **dst, uint16_t const *next, uint8_t const *flags, size_t nstate)
+{
+	struct emit em[1] = {{ 0x0 }};
+	struct jit *jit;
+	void *code;
+	int err = 0;
+
+	jit = calloc(1, sizeof *jit);
+	if (!jit) return ENOMEM;
+
+	jit->nstate = nstate;
+	jit->ent = calloc(nstate, sizeof *jit->ent);
+	em->arr = calloc(nstate, sizeof *em->arr);
+	if (!jit->ent || !em->arr) {
+		err = ENOMEM;
+		goto fail;
+	}
+
+	/* once to lay the blocks out, once to write them */
+	program(em, next, flags, nstate, jit->ent);
+
+	jit->siz = em->len;
+	code = mmap(0x0, jit->siz, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (code == MAP_FAILED) {
+		err = errno;
+		goto fail;
+	}
+	jit->code = code;
+
+	em->buf = jit->code;
+	em->len = 0;
+	program(em, next, flags, nstate, jit->ent);
+
+	/* never writable and executable at once */
+	if (mprotect(jit->code, jit->siz, PROT_READ | PROT_EXEC)) {
+		err = errno;
+		goto fail;
+	}
+
+	free(em->arr);
+	*dst = jit;
+	return 0;
+
+fail:
+	free(em->arr);
+	jit_free(jit);
+	return err;
+}
+
+#else
+
+int
+jit_alloc(struct jit **dst, uint16_t const *next, uint8_t const *flags, size_t nstate)
+{
+	/* there is nothing to compile to, so the interpreters go on as they are */
+	return ENOTSUP;
+}
+
+#endif
+
+void
+jit_free(struct jit *jit)
+{
+	if (!jit) return;
+
+	if (jit->code) munmap(jit->code, jit->siz);
+	free(jit->ent);
+	free(jit);
+}
+
+size_t
+jit_run(struct jit *jit, uint8_t const *txt, size_t pos, size_t stop, size_t *state, size_t *end)
+{
+	size_t out[2] = { *state, *end };
+	uint8_t *ent = jit->code + jit->ent[*state];
+	jit_fn *fn;
+
+	/* iso c has no cast from data to code, but the bytes are the same */
+	memcpy(&fn, &ent, sizeof fn);
+
+	pos = fn(txt, pos, stop, out);
+
+	*state = out[0];
+	*end = out[1];
+
+	return pos;
+}
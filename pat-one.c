@@ -0,0 +1,290 @@
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <pat.h>
+#include <pat.ih>
+
+enum {
+	one_new,
+	one_open,
+	one_done,
+};
+
+/*
+ * for each instruction, the bytes the instructions it reaches without
+ * consuming can take, and whether one of them is the halt
+ */
+struct onepass {
+	struct ins *prog;
+	size_t      len;
+	uint8_t   (*set)[32];
+	uint8_t    *halt;
+};
+
+struct scratch {
+	uint8_t *state;
+	size_t  *stk;
+	size_t   top;
+	size_t  *root;
+	size_t   nroot;
+};
+
+static bool set_has(uint8_t const *, uint8_t);
+static int  one_node(struct onepass *, struct scratch *, size_t);
+static int  one_prepare(struct onepass *, struct arena *);
+
+bool
+set_has(uint8_t const *set, uint8_t ch)
+{
+	return set[ch / 8] & 1 << ch % 8;
+}
+
+int
+one_node(struct onepass *op, struct scratch *sc, size_t pc)
+{
+	struct ins *ip = op->prog + pc;
+	size_t nx[2];
+	size_t nnx = 0;
+	size_t i;
+
+	switch (ip->op) {
+	case op_jump:
+		nx[nnx++] = pc + ip->arg;
+		break;
+	case op_fork:
+		nx[nnx++] = pc + ip->arg;
+		nx[nnx++] = pc + 1;
+		break;
+	case op_mark:
+	case op_save:
+	case op_bol:
+		nx[nnx++] = pc + 1;
+		break;
+	case op_char:
+	case op_clss:
+	case op_halt:
+		break;
+	default:
+		return ENOTSUP;
+	}
+
+	/* first time round, see to whatever it goes on to */
+	if (sc->state[pc] == one_new) {
+		sc->state[pc] = one_open;
+
+		for (i = 0; i < nnx; ++i) {
+			/* a loop that consumes nothing can go round any number of ways */
+			if (sc->state[nx[i]] == one_open) return ENOTSUP;
+			if (sc->state[nx[i]] == one_new) sc->stk[sc->top++] = nx[i];
+		}
+
+		return 0;
+	}
+
+	--sc->top;
+	sc->state[pc] = one_done;
+
+	/* past a byte, the search starts over */
+	if (ip->op == op_char || ip->op == op_clss) sc->root[sc->nroot++] = pc + 1;
+
+	switch (ip->op) {
+	case op_char:
+		op->set[pc][(uint8_t)ip->arg / 8] = 1 << (uint8_t)ip->arg % 8;
+		break;
+
+	case op_clss:
+		if (ip->arg) memcpy(op->set[pc], ip + ip->arg, 32);
+		else memset(op->set[pc], 0xff, 32);
+		break;
+
+	case op_halt:
+		op->halt[pc] = 1;
+		break;
+
+	case op_fork:
+		/* both ways taking the same byte, or both halting, is ambiguous */
+		if (op->halt[nx[0]] && op->halt[nx[1]]) return ENOTSUP;
+
+		for (i = 0; i < 32; ++i) {
+			if (op->set[nx[0]][i] & op->set[nx[1]][i]) return ENOTSUP;
+			op->set[pc][i] = op->set[nx[0]][i] | op->set[nx[1]][i];
+		}
+
+		op->halt[pc] = op->halt[nx[0]] | op->halt[nx[1]];
+		break;
+
+	default:
+		memcpy(op->set[pc], op->set[nx[0]], 32);
+		op->halt[pc] = op->halt[nx[0]];
+	}
+
+	return 0;
+}
+
+int
+one_prepare(struct onepass *op, struct arena *ar)
+{
+	struct scratch sc[1] = {{0}};
+	size_t pc;
+	int err = 0;
+
+	sc->state = arena_temp(ar, op->len, sizeof *sc->state);
+	sc->stk = arena_temp(ar, op->len * 2 + 1, sizeof *sc->stk);
+	sc->root = arena_temp(ar, op->len + 1, sizeof *sc->root);
+	if (!sc->state || !sc->stk || !sc->root) {
+		err = ENOMEM;
+		goto finally;
+	}
+
+	/* the .-loop in front is never one-pass, but the match is found already */
+	sc->root[sc->nroot++] = PROG_ENTRY;
+
+	while (sc->nroot && !err) {
+		pc = sc->root[--sc->nroot];
+		if (sc->state[pc] != one_new) continue;
+
+		sc->stk[sc->top++] = pc;
+
+		while (sc->top && !err) {
+			pc = sc->stk[sc->top - 1];
+
+			if (sc->state[pc] == one_done) --sc->top;
+			else err = one_node(op, sc, pc);
+		}
+	}
+
+finally:
+	arena_free(ar, sc->state);
+	arena_free(ar, sc->stk);
+	arena_free(ar, sc->root);
+
+	return err;
+}
+
+int
+one_alloc(struct onepass **dst, struct ins *prog, size_t len, struct arena *ar)
+{
+	struct onepass *op;
+	size_t mark = arena_mark(ar);
+	int err;
+
+	op = arena_keep(ar, 1, sizeof *op);
+	if (!op) return ENOMEM;
+
+	op->prog = prog;
+	op->len = len;
+	op->set = arena_keep(ar, len, sizeof *op->set);
+	op->halt = arena_keep(ar, len, sizeof *op->halt);
+	if (!op->set || !op->halt) {
+		err = ENOMEM;
+		goto fail;
+	}
+
+	err = one_prepare(op, ar);
+	if (err) goto fail;
+
+	*dst = op;
+	return 0;
+
+fail:
+	/* most programs are not one-pass, so what was kept for it goes back */
+	arena_free(ar, op->set);
+	arena_free(ar, op->halt);
+	arena_free(ar, op);
+	arena_undo(ar, mark);
+	return err;
+}
+
+void
+one_free(struct onepass *op)
+{
+	if (!op) return;
+
+	free(op->set);
+	free(op->halt);
+	free(op);
+}
+
+int
+one_mark(struct pattern *pat, size_t *nmat, size_t pos)
+{
+	if (*nmat == pat->msiz && mat_grow(pat, *nmat * 2)) return ENOMEM;
+
+	pat->mat[(*nmat)++] = (struct patmatch){ pos, -1 };
+
+	return 0;
+}
+
+void
+one_save(struct pattern *pat, size_t nmat, size_t pos)
+{
+	size_t i;
+
+	/* like thr_save, close the last submatch still open */
+	for (i = nmat - 1; i; --i) {
+		if (pat->mat[i].ext == -1UL) break;
+	}
+
+	pat->mat[i].ext = pos - pat->mat[i].off;
+}
+
+int
+one_match(struct pattern *pat, struct onepass *op, char const *str, size_t beg, size_t end)
+{
+	struct ins *prog = op->prog;
+	size_t nmat = 0;
+	size_t pos = beg;
+	size_t pc = PROG_ENTRY;
+	size_t alt;
+
+	/* one thread, whose submatches go straight into the pattern */
+	for (;;) switch (prog[pc].op) {
+	case op_char:
+	case op_clss:
+		if (pos == end) return PAT_ERR_NOMATCH;
+		if (!set_has(op->set[pc], str[pos])) return PAT_ERR_NOMATCH;
+
+		++pos;
+		++pc;
+		break;
+
+	case op_fork:
+		alt = pc + prog[pc].arg;
+
+		/* at most one way can go on, so take it */
+		if (pos == end) pc = op->halt[alt] ? alt : pc + 1;
+		else pc = set_has(op->set[alt], str[pos]) ? alt : pc + 1;
+		break;
+
+	case op_jump:
+		pc += prog[pc].arg;
+		break;
+
+	case op_mark:
+		if (one_mark(pat, &nmat, pos)) return ENOMEM;
+		++pc;
+		break;
+
+	case op_save:
+		one_save(pat, nmat, pos);
+		++pc;
+		break;
+
+	case op_bol:
+		if (pos) return PAT_ERR_NOMATCH;
+
+		++pc;
+		break;
+
+	case op_halt:
+		if (pos != end) return PAT_ERR_NOMATCH;
+
+		pat->nmat = nmat;
+		return 0;
+
+	default:
+		return ENOTSUP;
+	}
+}
@@ -21,16 +21,25 @@ struct parser {
 	enum state     st;
 	size_t         len;
 	size_t         siz;
+	uint8_t       *set;
+	size_t         nset;
+	int            last;
+	bool           neg;
+	bool           esc;
+	bool           rng;
 };
 
 static bool is_closed(struct parser *);
 static bool is_open(struct parser *);
 
 static enum type oper(uint8_t const *);
+static size_t    bound(uint8_t const **);
 
 static void pop_nop(struct parser *);
 
 static void push_alt(struct parser *);
+static void push_cls(struct parser *);
+static int  push_cnt(struct parser *, size_t, size_t);
 static void push_fini(struct parser *);
 static void push_mon(struct parser *, struct token *);
 static void push_nop(struct parser *);
@@ -45,19 +54,22 @@ static int shift_bra(struct parser *);
 
 static int shunt_alt(struct parser *);
 static int shunt_dot(struct parser *);
+static int shunt_dol(struct parser *);
 static int shunt_esc(struct parser *);
 static int shunt_eol(struct parser *);
+static int shunt_hat(struct parser *);
 static int shunt_lbr(struct parser *);
+static int shunt_lcb(struct parser *);
 static int shunt_lef(struct parser *);
 static int shunt_lit(struct parser *);
 static int shunt_rep(struct parser *);
 static int shunt_rbr(struct parser *);
 static int shunt_rit(struct parser *);
 
-static int parser_init(struct parser *, void const *);
+static int parser_init(struct parser *, void const *, struct arena *);
 static int parse(struct token **, struct parser *);
 
-static int (* const tab_shunt[255][st__len])() = {
+static int (* const tab_shunt[256][st__len])() = {
 	[0]    = { shunt_eol, shunt_eol, },
 	['\\'] = { shunt_esc, },
 	['?']  = { shunt_rep, },
@@ -68,6 +80,9 @@ static int (* const tab_shunt[255][st__len])() = {
 	[')']  = { shunt_rit, },
 	['.']  = { shunt_dot, },
 	['[']  = { shunt_lbr, },
+	['{']  = { shunt_lcb, },
+	['^']  = { shunt_hat, },
+	['$']  = { shunt_dol, },
 	[']']  = { shunt_rbr, },
 };
 
@@ -103,6 +118,21 @@ oper(uint8_t const *src)
 	return tab[*src];
 }
 
+size_t
+bound(uint8_t const **src)
+{
+	size_t ret = 0;
+
+	if (**src < '0' || **src > '9') return -1;
+
+	/* anything past REP_MAX is refused, so stop counting there */
+	for (; **src >= '0' && **src <= '9'; ++*src) {
+		if (ret <= REP_MAX) ret = ret * 10 + **src - '0';
+	}
+
+	return ret;
+}
+
 void
 pop_nop(struct parser *pa)
 {
@@ -124,6 +154,38 @@ push_alt(struct parser *pa)
 	};
 }
 
+void
+push_cls(struct parser *pa)
+{
+	size_t i;
+
+	if (pa->neg) for (i = 0; i < 32; ++i) pa->set[i] = ~pa->set[i];
+
+	push_res(pa, (struct token[]){{ .id = type_cls, .set = pa->set }});
+	pa->set += 32;
+}
+
+int
+push_cnt(struct parser *pa, size_t min, size_t max)
+{
+	struct token *chld = pa->res;
+	struct token *tok = pa->res + 1;
+	size_t len;
+
+	*tok = (struct token){ .id = type_cnt, .min = min, .max = max };
+	tok->siz = chld->siz + 1;
+
+	len = cnt_len(tok);
+	if (pa->len + len - chld->len > INT16_MAX) return PAT_ERR_BADREP;
+
+	pa->siz += 1;
+	pa->len += len - chld->len;
+	tok->len = len;
+	++pa->res;
+
+	return 0;
+}
+
 void
 push_fini(struct parser *pa)
 {
@@ -205,7 +267,41 @@ shift(struct parser *pa)
 int
 shift_bra(struct parser *pa)
 {
-	return -2;
+	uint8_t ch = *pa->src++;
+	int lo;
+
+	if (!ch) return PAT_ERR_BADCLASS;
+
+	if (pa->esc) {
+		pa->esc = false;
+	} else if (ch == '^' && !pa->nset && !pa->neg) {
+		pa->neg = true;
+		return 0;
+	} else if (ch == ']' && pa->nset) {
+		if (pa->rng) pa->set['-' / 8] |= 1 << '-' % 8;
+		push_cls(pa);
+		pa->st = st_init;
+		return 0;
+	} else if (ch == '\\') {
+		pa->esc = true;
+		return 0;
+	} else if (ch == '-' && pa->last != -1 && !pa->rng) {
+		pa->rng = true;
+		return 0;
+	}
+
+	++pa->nset;
+
+	/* a dash with nothing to its left or right stands for itself */
+	lo = pa->rng ? pa->last : ch;
+	if (lo > ch) return PAT_ERR_BADCLASS;
+
+	for (; lo <= ch; ++lo) pa->set[lo / 8] |= 1 << lo % 8;
+
+	pa->last = pa->rng ? -1 : ch;
+	pa->rng = false;
+
+	return 0;
 }
 
 int
@@ -235,6 +331,13 @@ shunt_dot(struct parser *pa)
 	return 0;
 }
 
+int
+shunt_dol(struct parser *pa)
+{
+	push_res(pa, token(type_eol));
+	return 0;
+}
+
 int
 shunt_esc(struct parser *pa)
 {
@@ -251,10 +354,56 @@ shunt_eol(struct parser *pa)
 	return -1;
 }
 
+int
+shunt_hat(struct parser *pa)
+{
+	push_res(pa, token(type_bol));
+	return 0;
+}
+
 int
 shunt_lbr(struct parser *pa)
 {
-	return -2;
+	pa->st = st_bra;
+	pa->nset = 0;
+	pa->last = -1;
+	pa->neg = false;
+	pa->rng = false;
+
+	return 0;
+}
+
+int
+shunt_lcb(struct parser *pa)
+{
+	uint8_t const *at = pa->src + 1;
+	size_t min;
+	size_t max;
+
+	/* a brace with nothing to repeat or no bound stands for itself */
+	switch (pa->res->id) {
+	case type_nil:
+	case type_nop:
+	case type_alt:
+		return shunt_lit(pa);
+	}
+
+	min = bound(&at);
+	max = min;
+
+	if (min != -1UL && *at == ',') {
+		++at;
+		max = *at == '}' ? REP_INF : bound(&at);
+	}
+
+	if (min == -1UL || max == -1UL || *at != '}') return shunt_lit(pa);
+	if (min > REP_MAX || (max != REP_INF && (max > REP_MAX || max < min))) {
+		return PAT_ERR_BADREP;
+	}
+
+	pa->src = at;
+
+	return push_cnt(pa, min, max);
 }
 
 int
@@ -281,7 +430,8 @@ shunt_rep(struct parser *pa)
 int
 shunt_rbr(struct parser *pa)
 {
-	return -2;
+	/* outside a bracket it is just a character */
+	return shunt_lit(pa);
 }
 
 int
@@ -309,40 +459,56 @@ parse(struct token **dst, struct parser *pa)
 }
 
 int
-parser_init(struct parser *pa, void const *src)
+parser_init(struct parser *pa, void const *src, struct arena *ar)
 {
+	uint8_t const *at;
 	size_t len = strlen(src);
+	size_t nbra = 0;
 
-	pa->res = calloc(len * 2 + 6, sizeof *pa->res);
+	for (at = src; *at; ++at) nbra += *at == '[';
+
+	/* bracket bitmaps live behind the tokens so tok_free frees both */
+	pa->res = arena_temp(ar, 1, (len * 2 + 6) * sizeof *pa->res + nbra * 32);
 	if (!pa->res) return ENOMEM;
 
 	pa->src = src;
+	pa->set = (uint8_t *)(pa->res + len * 2 + 6);
 
 	return 0;
 }
 
 void
-tok_free(struct token *tok)
+tok_free(struct token *tok, struct arena *ar)
 {
 	if (!tok) return;
 	while (tok->id) --tok;
-	free(tok);
+	arena_free(ar, tok);
+}
+
+size_t
+tok_nsub(struct token *tok)
+{
+	size_t ret = 0;
+
+	for (; tok->id; --tok) ret += tok->id == type_sub;
+
+	return ret;
 }
 
 int
-pat_parse(struct token **dst, char const *src)
+pat_parse(struct token **dst, char const *src, struct arena *ar)
 {
 	struct parser pa[1] = {0};
 	int err;
 
-	err = parser_init(pa, src);
+	err = parser_init(pa, src, ar);
 	if (err) goto finally;
 
 	err = parse(dst, pa);
 	if (err) goto finally;
 
 finally:
-	if (err) tok_free(pa->res);
+	if (err) tok_free(pa->res, ar);
 
 	return err;
 }
@@ -0,0 +1,280 @@
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <util.h>
+#include <pat.h>
+#include <pat.ih>
+
+enum {
+	plan_new,
+	plan_open,
+	plan_done,
+};
+
+static int    plan_max(size_t *, struct ins *, size_t, struct arena *);
+static int    plan_min(size_t *, struct ins *, size_t, struct arena *);
+static int    plan_run(struct pattern *, struct patplan *, size_t, struct arena *);
+static size_t plan_suf(char *, struct ins *, size_t, struct arena *);
+
+int
+plan_max(size_t *dst, struct ins *prog, size_t len, struct arena *ar)
+{
+	uint8_t *state;
+	size_t *ext;
+	size_t *stk;
+	size_t top = 0;
+	size_t nx[2];
+	size_t nnx;
+	size_t pc;
+	size_t i;
+	int err = 0;
+
+	*dst = -1;
+
+	/* a counted loop is too long to walk, so leave it without a bound */
+	for (pc = 0; pc < len; ++pc) {
+		if (prog[pc].op == op_loop) return 0;
+	}
+
+	state = arena_temp(ar, len, sizeof *state);
+	ext = arena_temp(ar, len, sizeof *ext);
+	stk = arena_temp(ar, len * 2 + 1, sizeof *stk);
+	if (!state || !ext || !stk) {
+		err = ENOMEM;
+		goto finally;
+	}
+
+	stk[top++] = PROG_ENTRY;
+
+	while (top) {
+		pc = stk[top - 1];
+
+		if (state[pc] == plan_done) {
+			--top;
+			continue;
+		}
+
+		nnx = 0;
+		switch (prog[pc].op) {
+		case op_fork:
+			nx[nnx++] = pc + prog[pc].arg;
+			nx[nnx++] = pc + 1;
+			break;
+		case op_jump:
+			nx[nnx++] = pc + prog[pc].arg;
+			break;
+		case op_halt:
+			break;
+		default:
+			nx[nnx++] = pc + 1;
+		}
+
+		if (state[pc] == plan_new) {
+			state[pc] = plan_open;
+
+			for (i = 0; i < nnx; ++i) {
+				/* any way back round can be taken again */
+				if (state[nx[i]] == plan_open) goto finally;
+				if (state[nx[i]] == plan_new) stk[top++] = nx[i];
+			}
+
+			continue;
+		}
+
+		--top;
+		state[pc] = plan_done;
+
+		for (i = 0; i < nnx; ++i) ext[pc] = umax(ext[pc], ext[nx[i]]);
+		if (prog[pc].op == op_char || prog[pc].op == op_clss) ++ext[pc];
+	}
+
+	*dst = ext[PROG_ENTRY];
+
+finally:
+	arena_free(ar, state);
+	arena_free(ar, ext);
+	arena_free(ar, stk);
+	return err;
+}
+
+int
+plan_min(size_t *dst, struct ins *prog, size_t len, struct arena *ar)
+{
+	uint8_t *seen;
+	size_t *stk[2];
+	size_t top[2] = {0};
+	size_t ext = 0;
+	size_t pc;
+	int err = 0;
+
+	*dst = 0;
+
+	seen = arena_temp(ar, len, sizeof *seen);
+	stk[0] = arena_temp(ar, len * 2 + 1, sizeof *stk[0]);
+	stk[1] = arena_temp(ar, len * 2 + 1, sizeof *stk[1]);
+	if (!seen || !stk[0] || !stk[1]) {
+		err = ENOMEM;
+		goto finally;
+	}
+
+	/*
+	 * everything reachable without consuming goes in this round, the
+	 * rest in the next, so the first halt seen is the nearest; a count
+	 * or a ^ is not checked, which only makes the bound lower
+	 */
+	stk[0][top[0]++] = PROG_ENTRY;
+
+	for (; top[0]; ++ext) {
+		while (top[0]) {
+			pc = stk[0][--top[0]];
+			if (seen[pc]) continue;
+			seen[pc] = 1;
+
+			switch (prog[pc].op) {
+			case op_halt:
+				*dst = ext;
+				goto finally;
+			case op_char:
+			case op_clss:
+				stk[1][top[1]++] = pc + 1;
+				break;
+			case op_fork:
+				stk[0][top[0]++] = pc + prog[pc].arg;
+				stk[0][top[0]++] = pc + 1;
+				break;
+			case op_jump:
+				stk[0][top[0]++] = pc + prog[pc].arg;
+				break;
+			default:
+				stk[0][top[0]++] = pc + 1;
+			}
+		}
+
+		ptr_swap(&stk[0], &stk[1]);
+		top[0] = top[1];
+		top[1] = 0;
+	}
+
+finally:
+	arena_free(ar, seen);
+	arena_free(ar, stk[0]);
+	arena_free(ar, stk[1]);
+	return err;
+}
+
+size_t
+plan_suf(char *dst, struct ins *prog, size_t len, struct arena *ar)
+{
+	uint8_t *into;
+	size_t pc;
+	size_t ret = 0;
+
+	into = arena_temp(ar, len, sizeof *into);
+	if (!into) return -1;
+
+	for (pc = 0; pc < len; ++pc) {
+		if (prog[pc].op == op_fork || prog[pc].op == op_jump) into[pc + prog[pc].arg] = 1;
+	}
+
+	/* back from the halt, as far as nothing jumps in part way */
+	for (pc = len - 2; pc > 0; --pc) {
+		if (prog[pc].op == op_char) dst[len - ++ret] = prog[pc].arg;
+		else if (prog[pc].op != op_mark && prog[pc].op != op_save) break;
+
+		if (into[pc]) break;
+	}
+
+	memmove(dst, dst + len - ret, ret);
+	arena_free(ar, into);
+
+	return ret;
+}
+
+int
+plan_run(struct pattern *pat, struct patplan *plan, size_t len, struct arena *ar)
+{
+	int err;
+
+	if (prog_vm(pat->prog, len)) {
+		plan->find = PAT_VM;
+		plan->sub = pat->nsub ? PAT_VM : PAT_NONE;
+		return 0;
+	}
+
+	if (shift_fits(pat->prog, len)) {
+		plan->find = PAT_SHIFT;
+		err = shift_alloc(&pat->sft, pat->prog, len, ar);
+	} else {
+		plan->find = PAT_DFA;
+		/* a dfa grows as it runs, so one in a buffer is made on the heap when first run */
+		err = ar ? 0 : dfa_alloc(&pat->dfa, pat->prog, len);
+	}
+	if (err) return err;
+
+	if (!pat->nsub) {
+		plan->sub = PAT_NONE;
+		return 0;
+	}
+
+	/* with no choice to make at any byte, one thread is enough for submatches */
+	err = one_alloc(&pat->one, pat->prog, len, ar);
+	if (err != ENOTSUP) {
+		plan->sub = PAT_ONEPASS;
+		plan->onepass = true;
+		return err;
+	}
+
+	plan->sub = PAT_BACKTRACK;
+	plan->back = BACK_MAX / len ? BACK_MAX / len - 1 : 0;
+
+	return 0;
+}
+
+char const *
+pat_engine(enum patengine eng)
+{
+	static char const *const name[] = {
+		[PAT_NONE]      = "none",
+		[PAT_VM]        = "vm",
+		[PAT_SHIFT]     = "shift-and",
+		[PAT_DFA]       = "dfa",
+		[PAT_ONEPASS]   = "one-pass",
+		[PAT_BACKTRACK] = "backtrack",
+	};
+
+	return eng < array_len(name) ? name[eng] : "unknown";
+}
+
+int
+pat_plan(struct pattern *pat, struct arena *ar)
+{
+	struct patplan *plan;
+	size_t len = prog_len(pat->prog);
+	char *lit;
+	int err;
+
+	plan = arena_keep(ar, 1, sizeof *plan + len * 2);
+	if (!plan) return ENOMEM;
+
+	pat->plan = plan;
+	lit = (char *)(plan + 1);
+
+	plan->nsub = pat->nsub;
+	plan->anchored = prog_anchored(pat->prog);
+
+	plan->pre = lit;
+	plan->npre = prefix_lit(lit, pat->prog);
+
+	plan->suf = lit + len;
+	plan->nsuf = plan_suf(lit + len, pat->prog, len, ar);
+	if (plan->nsuf == -1UL) return ENOMEM;
+
+	err = plan_min(&plan->min, pat->prog, len, ar);
+	if (err) return err;
+
+	err = plan_max(&plan->max, pat->prog, len, ar);
+	if (err) return err;
+
+	return plan_run(pat, plan, len, ar);
+}
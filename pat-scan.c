@@ -0,0 +1,313 @@
+#include <errno.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <util.h>
+#include <pat.h>
+#include <pat.ih>
+
+/* least text worth a chunk, and chunks per worker to even out the load */
+#define SCAN_CHUNK (1 << 16)
+#define SCAN_SPLIT 4
+
+/* matches a chunk keeps when only counting, to line up with the one before */
+#define SCAN_KEEP 64
+
+struct chunk {
+	size_t           beg;
+	size_t           end;
+	size_t           n;
+	size_t           nmat;
+	size_t           cap;
+	struct patmatch *mat;
+	struct patmatch  tail;
+};
+
+struct scan {
+	pthread_mutex_t  lock;
+	struct pattern  *pat;
+	char const      *buf;
+	size_t           len;
+	size_t           keep;
+	size_t           next;
+	size_t           nchunk;
+	struct chunk    *chunk;
+	int              err;
+};
+
+static int   chunk_add(struct chunk *, struct patmatch const *, size_t);
+static int   chunk_scan(struct scan *, struct chunk *, struct patiter *);
+static int   scan_copy(struct pattern *, struct pattern *);
+static int   scan_merge(struct scan *, struct chunk *);
+static int   scan_run(struct pattern *, char const *, size_t, size_t, size_t, struct chunk *);
+static void *scan_work(void *);
+
+int
+chunk_add(struct chunk *ch, struct patmatch const *mat, size_t keep)
+{
+	struct patmatch *tmp;
+	size_t cap;
+
+	++ch->n;
+	ch->tail = *mat;
+
+	if (ch->nmat == keep) return 0;
+
+	if (ch->nmat == ch->cap) {
+		cap = ch->cap ? ch->cap * 2 : 16;
+		tmp = realloc(ch->mat, cap * sizeof *tmp);
+		if (!tmp) return ENOMEM;
+
+		ch->mat = tmp;
+		ch->cap = cap;
+	}
+
+	ch->mat[ch->nmat++] = *mat;
+
+	return 0;
+}
+
+int
+chunk_scan(struct scan *sc, struct chunk *ch, struct patiter *it)
+{
+	struct patmatch mat;
+	int err;
+
+	/* matches start in the chunk but may run on past its end */
+	it->pos = ch->beg;
+	it->last = -1;
+
+	while (!(err = iter_next(it, &mat, ch->end))) {
+		err = chunk_add(ch, &mat, sc->keep);
+		if (err) return err;
+	}
+
+	return err == PAT_ERR_NOMATCH ? 0 : err;
+}
+
+int
+scan_copy(struct pattern *dst, struct pattern *src)
+{
+	/* the lazy dfa and the matches are written as a pattern runs */
+	*dst = *src;
+	dst->dfa = 0x0;
+
+	/* nor may a hot copy hand its dfa to a cache entry */
+	dst->ent = 0x0;
+
+	/* a copy's matches are its own, even of a pattern in a buffer */
+	dst->mat = calloc(src->msiz, sizeof *dst->mat);
+	if (!dst->mat) return ENOMEM;
+	dst->spilled = true;
+
+	if (!src->dfa) return 0;
+
+	return dfa_alloc(&dst->dfa, src->prog, prog_len(src->prog));
+}
+
+int
+scan_merge(struct scan *sc, struct chunk *out)
+{
+	struct patiter it[1] = {{0}};
+	struct patmatch mat;
+	struct chunk *ch;
+	size_t keep = sc->keep == -1UL ? -1UL : 0;
+	size_t i;
+	size_t j;
+	int err;
+
+	err = pat_iter_init(it, sc->pat, sc->buf, sc->len);
+	if (err) goto finally;
+
+	for (ch = sc->chunk; ch < sc->chunk + sc->nchunk; ++ch) {
+		j = 0;
+
+		if (it->pos > ch->beg) {
+			/*
+			 * a match ran on into this chunk, so search again from its
+			 * end until a match lines up with one the chunk found
+			 */
+			while (!(err = iter_next(it, &mat, ch->end))) {
+				while (j < ch->nmat && ch->mat[j].off < mat.off) ++j;
+				if (j < ch->nmat && ch->mat[j].ext == mat.ext && ch->mat[j].off == mat.off) break;
+
+				err = chunk_add(out, &mat, keep);
+				if (err) goto finally;
+			}
+
+			if (err == PAT_ERR_NOMATCH) continue;
+			if (err) goto finally;
+
+		/* the worker could not know the last match ended where this empty one is */
+		} else if (ch->nmat && !ch->mat[0].ext && ch->mat[0].off == it->last) j = 1;
+
+		if (j == ch->n) continue;
+
+		for (i = j; i < ch->nmat; ++i) {
+			err = chunk_add(out, ch->mat + i, keep);
+			if (err) goto finally;
+		}
+
+		out->n += ch->n - ch->nmat;
+
+		it->last = ch->tail.off + ch->tail.ext;
+		it->pos = it->last + !ch->tail.ext;
+	}
+
+	err = 0;
+
+finally:
+	pat_iter_fini(it);
+	return err;
+}
+
+int
+scan_run(struct pattern *pat, char const *buf, size_t len, size_t nthr, size_t keep, struct chunk *out)
+{
+	struct scan sc = {
+		.pat  = pat,
+		.buf  = buf,
+		.len  = len,
+		.keep = keep,
+	};
+	pthread_t *thr = 0x0;
+	long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+	size_t nrun = 0;
+	size_t i;
+	int err = 0;
+
+	if (!nthr) nthr = ncpu > 0 ? ncpu : 1;
+
+	sc.nchunk = umax(umin(len / SCAN_CHUNK, nthr * SCAN_SPLIT), 1);
+
+	/* anchored, each match has to start where the one before ended */
+	if (prog_anchored(pat->prog)) sc.nchunk = 1;
+
+	sc.chunk = calloc(sc.nchunk, sizeof *sc.chunk);
+	if (!sc.chunk) return ENOMEM;
+
+	/* the last chunk takes an empty match at the very end too */
+	for (i = 0; i < sc.nchunk; ++i) {
+		sc.chunk[i].beg = len / sc.nchunk * i;
+		sc.chunk[i].end = len / sc.nchunk * (i + 1);
+	}
+
+	sc.chunk[sc.nchunk - 1].end = len + 1;
+
+	nthr = umin(nthr, sc.nchunk);
+
+	if (nthr > 1) {
+		thr = calloc(nthr - 1, sizeof *thr);
+		if (!thr) {
+			err = ENOMEM;
+			goto finally;
+		}
+	}
+
+	err = pthread_mutex_init(&sc.lock, 0x0);
+	if (err) goto finally;
+
+	/* a worker that will not start leaves its share to the others */
+	for (; nrun < nthr - 1; ++nrun) {
+		if (pthread_create(thr + nrun, 0x0, scan_work, &sc)) break;
+	}
+
+	scan_work(&sc);
+
+	for (i = 0; i < nrun; ++i) pthread_join(thr[i], 0x0);
+
+	pthread_mutex_destroy(&sc.lock);
+
+	err = sc.err;
+	if (err) goto finally;
+
+	err = scan_merge(&sc, out);
+
+finally:
+	for (i = 0; i < sc.nchunk; ++i) free(sc.chunk[i].mat);
+	free(sc.chunk);
+	free(thr);
+
+	return err;
+}
+
+void *
+scan_work(void *arg)
+{
+	struct scan *sc = arg;
+	struct pattern pat[1];
+	struct patiter it[1] = {{0}};
+	struct chunk *ch;
+	int err;
+
+	err = scan_copy(pat, sc->pat);
+	if (err) goto finally;
+
+	err = pat_iter_init(it, pat, sc->buf, sc->len);
+	if (err) goto finally;
+
+	for (;;) {
+		pthread_mutex_lock(&sc->lock);
+		ch = sc->err || sc->next == sc->nchunk ? 0x0 : sc->chunk + sc->next++;
+		pthread_mutex_unlock(&sc->lock);
+
+		if (!ch) break;
+
+		err = chunk_scan(sc, ch, it);
+		if (err) break;
+	}
+
+finally:
+	pat_iter_fini(it);
+	dfa_free(pat->dfa);
+	free(pat->mat);
+
+	if (err) {
+		pthread_mutex_lock(&sc->lock);
+		if (!sc->err) sc->err = err;
+		pthread_mutex_unlock(&sc->lock);
+	}
+
+	return 0x0;
+}
+
+int
+pat_count(struct pattern *pat, char const *buf, size_t len, size_t nthr, size_t *dst)
+{
+	struct chunk out = {0};
+	int err;
+
+	if (!pat) return EFAULT;
+	if (!buf) return EFAULT;
+	if (!dst) return EFAULT;
+
+	err = scan_run(pat, buf, len, nthr, SCAN_KEEP, &out);
+	if (!err) *dst = out.n;
+
+	return err;
+}
+
+int
+pat_scan(struct pattern *pat, char const *buf, size_t len, size_t nthr, struct patmatch **dst, size_t *n)
+{
+	struct chunk out = {0};
+	int err;
+
+	if (!pat) return EFAULT;
+	if (!buf) return EFAULT;
+	if (!dst) return EFAULT;
+	if (!n) return EFAULT;
+
+	err = scan_run(pat, buf, len, nthr, -1, &out);
+	if (err) {
+		free(out.mat);
+		return err;
+	}
+
+	*dst = out.mat;
+	*n = out.n;
+
+	return 0;
+}
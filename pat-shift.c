@@ -0,0 +1,328 @@
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <util.h>
+#include <pat.h>
+#include <pat.ih>
+
+#define SHIFT_MAX 64
+
+struct scratch {
+	int16_t *pos;
+	uint8_t *seen;
+	size_t  *stk;
+	size_t   len;
+	bool     bol;
+};
+
+struct shift {
+	size_t    npos;
+	size_t    nchk;
+	bool      empty;
+	bool      anchored;
+	uint64_t  first;
+	uint64_t  last;
+	uint64_t  cls[256];
+	uint64_t *fwd;
+	uint64_t *rev;
+};
+
+static bool     ins_consumes(struct ins *);
+static uint64_t reach(struct scratch *, struct ins *, size_t, bool *);
+static uint64_t follow(uint64_t *, size_t, uint64_t);
+static void     table(uint64_t *, size_t, uint64_t *);
+
+static size_t back(struct shift *, char const *, size_t);
+static size_t longest(struct shift *, char const *, size_t, size_t);
+static size_t scan(struct shift *, struct pattern *, char const *, size_t, size_t);
+
+static int shift_prepare(struct shift *, struct ins *, size_t, struct arena *);
+
+bool
+ins_consumes(struct ins *ip)
+{
+	return ip->op == op_char || ip->op == op_clss;
+}
+
+uint64_t
+reach(struct scratch *sc, struct ins *prog, size_t pc, bool *halt)
+{
+	uint64_t ret = 0;
+	size_t top = 0;
+
+	memset(sc->seen, 0, sc->len);
+	sc->stk[top++] = pc;
+
+	while (top) {
+		pc = sc->stk[--top];
+		if (sc->seen[pc]) continue;
+		sc->seen[pc] = 1;
+
+		switch (prog[pc].op) {
+		case op_char:
+		case op_clss:
+			ret |= 1ULL << sc->pos[pc];
+			break;
+		case op_fork:
+			sc->stk[top++] = pc + prog[pc].arg;
+			sc->stk[top++] = pc + 1;
+			break;
+		case op_jump:
+			sc->stk[top++] = pc + prog[pc].arg;
+			break;
+		case op_mark:
+		case op_save:
+			sc->stk[top++] = pc + 1;
+			break;
+		case op_bol:
+			if (sc->bol) sc->stk[top++] = pc + 1;
+			break;
+		case op_halt:
+			*halt = true;
+			break;
+		}
+	}
+
+	return ret;
+}
+
+uint64_t
+follow(uint64_t *tab, size_t nchk, uint64_t set)
+{
+	uint64_t ret = 0;
+	size_t i;
+
+	for (i = 0; i < nchk; ++i) ret |= tab[i * 256 + (set >> i * 8 & 0xff)];
+
+	return ret;
+}
+
+void
+table(uint64_t *tab, size_t nchk, uint64_t *set)
+{
+	size_t i;
+	size_t b;
+	size_t j;
+
+	/* each entry is one with its top bit less, plus that bit's set */
+	for (i = 0; i < nchk; ++i, tab += 256) for (j = 0; j < 8; ++j) {
+		for (b = 0; b < 1U << j; ++b) tab[b | 1U << j] = tab[b] | set[i * 8 + j];
+	}
+}
+
+int
+shift_prepare(struct shift *sf, struct ins *prog, size_t len, struct arena *ar)
+{
+	struct scratch sc[1] = {{ .len = len }};
+	uint64_t fol[SHIFT_MAX] = {0};
+	uint64_t pre[SHIFT_MAX] = {0};
+	size_t at[SHIFT_MAX];
+	uint8_t const *set;
+	size_t pc;
+	size_t p;
+	size_t q;
+	size_t ch;
+	bool halt;
+	int err = 0;
+
+	sc->pos = arena_temp(ar, len, sizeof *sc->pos);
+	sc->seen = arena_temp(ar, len, sizeof *sc->seen);
+	sc->stk = arena_temp(ar, len * 2 + 1, sizeof *sc->stk);
+	if (!sc->pos || !sc->seen || !sc->stk) {
+		err = ENOMEM;
+		goto finally;
+	}
+
+	for (pc = PROG_ENTRY; pc < len; ++pc) {
+		if (!ins_consumes(prog + pc)) continue;
+		at[sf->npos] = pc;
+		sc->pos[pc] = sf->npos++;
+	}
+
+	/* a ^ only holds on the way in, before anything is consumed */
+	sc->bol = true;
+	sf->first = reach(sc, prog, PROG_ENTRY, &sf->empty);
+	sc->bol = false;
+	sf->anchored = prog_anchored(prog);
+
+	for (p = 0; p < sf->npos; ++p) {
+		halt = false;
+		fol[p] = reach(sc, prog, at[p] + 1, &halt);
+		if (halt) sf->last |= 1ULL << p;
+
+		for (q = 0; q < sf->npos; ++q) {
+			if (fol[p] & 1ULL << q) pre[q] |= 1ULL << p;
+		}
+
+		if (prog[at[p]].op == op_char) {
+			sf->cls[(uint8_t)prog[at[p]].arg] |= 1ULL << p;
+			continue;
+		}
+
+		/* an empty offset is the .-loop's class, which takes anything */
+		set = prog[at[p]].arg ? (void const *)(prog + at[p] + prog[at[p]].arg) : 0x0;
+		for (ch = 0; ch < 256; ++ch) {
+			if (!set || set[ch / 8] & 1 << ch % 8) sf->cls[ch] |= 1ULL << p;
+		}
+	}
+
+	sf->nchk = (sf->npos + 7) / 8;
+	sf->fwd = arena_keep(ar, sf->nchk * 256, sizeof *sf->fwd);
+	sf->rev = arena_keep(ar, sf->nchk * 256, sizeof *sf->rev);
+	if (!sf->fwd || !sf->rev) {
+		err = ENOMEM;
+		goto finally;
+	}
+
+	table(sf->fwd, sf->nchk, fol);
+	table(sf->rev, sf->nchk, pre);
+
+finally:
+	arena_free(ar, sc->pos);
+	arena_free(ar, sc->seen);
+	arena_free(ar, sc->stk);
+	return err;
+}
+
+bool
+shift_fits(struct ins *prog, size_t len)
+{
+	size_t npos = 0;
+	size_t pc;
+
+	for (pc = PROG_ENTRY; pc < len; ++pc) npos += ins_consumes(prog + pc);
+
+	return npos <= SHIFT_MAX;
+}
+
+int
+shift_alloc(struct shift **dst, struct ins *prog, size_t len, struct arena *ar)
+{
+	struct shift *sf;
+	int err;
+
+	if (!shift_fits(prog, len)) return EOVERFLOW;
+
+	sf = arena_keep(ar, 1, sizeof *sf);
+	if (!sf) return ENOMEM;
+
+	err = shift_prepare(sf, prog, len, ar);
+	if (err) goto fail;
+
+	*dst = sf;
+	return 0;
+
+fail:
+	arena_free(ar, sf->fwd);
+	arena_free(ar, sf->rev);
+	arena_free(ar, sf);
+	return err;
+}
+
+void
+shift_free(struct shift *sf)
+{
+	if (!sf) return;
+
+	free(sf->fwd);
+	free(sf->rev);
+	free(sf);
+}
+
+size_t
+scan(struct shift *sf, struct pattern *pat, char const *str, size_t len, size_t lim)
+{
+	uint8_t const *txt = (void const *)str;
+	uint64_t set = 0;
+	size_t i;
+
+	for (i = 0; i < len; ++i) {
+		if (!set && pat->pre) i = pre_scan(pat->pre, str, umin(len, lim), i);
+		if (!set && i >= umin(len, lim)) break;
+
+		set = follow(sf->fwd, sf->nchk, set);
+		if (i < lim) set |= sf->first;
+		set &= sf->cls[txt[i]];
+
+		if (set & sf->last) return i + 1;
+	}
+
+	return -1;
+}
+
+size_t
+back(struct shift *sf, char const *str, size_t end)
+{
+	uint8_t const *txt = (void const *)str;
+	uint64_t set = sf->last;
+	size_t beg = end;
+	size_t i;
+
+	for (i = end; i-- > 0;) {
+		set &= sf->cls[txt[i]];
+		if (!set) break;
+		if (set & sf->first) beg = i;
+		set = follow(sf->rev, sf->nchk, set);
+	}
+
+	return beg;
+}
+
+size_t
+longest(struct shift *sf, char const *str, size_t len, size_t beg)
+{
+	uint8_t const *txt = (void const *)str;
+	uint64_t set = sf->first;
+	size_t end = beg;
+	size_t i;
+
+	for (i = beg; i < len; ++i) {
+		set &= sf->cls[txt[i]];
+		if (!set) break;
+		if (set & sf->last) end = i + 1;
+		set = follow(sf->fwd, sf->nchk, set);
+	}
+
+	return end;
+}
+
+int
+shift_match(struct pattern *pat, struct shift *sf, char const *str, size_t len, size_t lim)
+{
+	size_t beg = 0;
+	size_t end;
+
+	/* an anchored match can only start at 0 */
+	if (sf->anchored) {
+		end = longest(sf, str, len, 0);
+		if (!end && !sf->empty) return PAT_ERR_NOMATCH;
+
+		pat->nmat = 1;
+		pat->mat[0] = (struct patmatch){ 0, end };
+		return 0;
+	}
+
+	/*
+	 * find the first match to end, walk back to its leftmost start,
+	 * then look again for a match starting before that until none does
+	 */
+	if (!sf->empty) {
+		end = scan(sf, pat, str, len, lim);
+		if (end == -1UL) return PAT_ERR_NOMATCH;
+
+		beg = back(sf, str, end);
+
+		while (beg && (end = scan(sf, pat, str, len, beg)) != -1UL) {
+			beg = back(sf, str, end);
+		}
+	}
+
+	end = longest(sf, str, len, beg);
+
+	pat->nmat = 1;
+	pat->mat[0] = (struct patmatch){ beg, end - beg };
+
+	return 0;
+}
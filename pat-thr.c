@@ -5,6 +5,54 @@
 #include <util.h>
 #include <pat.ih>
 
+static struct capture *cap_get(struct capture **, size_t);
+static int             mat_cmp(struct patmatch *, struct patmatch *);
+static int             thr_own(struct capture **, struct thread *, size_t);
+
+/*
+ * submatches past the first are kept in blocks of the program's group
+ * count, newest first; blocks are shared between threads until written,
+ * so a repeated group's earlier iterations are never copied again
+ */
+
+struct capture *
+cap_get(struct capture **cfl, size_t len)
+{
+	struct capture *ret = *cfl;
+
+	if (ret) {
+		*cfl = ret->next;
+		if (ret->len == len) return ret;
+		free(ret);
+	}
+
+	ret = malloc(sizeof *ret + len * sizeof *ret->mat);
+	if (!ret) return 0x0;
+
+	ret->len = len;
+
+	return ret;
+}
+
+void
+cap_free(struct capture *cap)
+{
+	struct capture *a;
+
+	while (cap) a = cap, cap = a->next, free(a);
+}
+
+int
+mat_cmp(struct patmatch *lt, struct patmatch *rt)
+{
+	ptrdiff_t cmp;
+
+	cmp = ucmp(lt->off, rt->off);
+	if (cmp) return -cmp;
+
+	return ucmp(lt->ext, rt->ext);
+}
+
 int
 thr_alloc(struct thread *thr[static 2])
 {
@@ -22,31 +70,69 @@ thr_alloc(struct thread *thr[static 2])
 int
 thr_cmp(struct thread *lt, struct thread *rt)
 {
-	size_t i;
+	struct capture *l;
+	struct capture *r;
 	size_t min;
-	ptrdiff_t cmp;
+	size_t len;
+	size_t top;
+	size_t i;
+	int cmp;
+	int ret = 0;
 
 	if (!lt && !rt) return 0;
 	if (!lt) return -1;
 	if (!rt) return  1;
 
 	min = umin(lt->nmat, rt->nmat);
+	if (!min) return 0;
+
+	cmp = mat_cmp(&lt->mat, &rt->mat);
+	if (cmp || min == 1) return cmp;
+
+	l = lt->cap;
+	r = rt->cap;
+	len = l->len;
+
+	for (i = (lt->nmat - 2) / len - (min - 2) / len; i; --i) l = l->next;
+	for (i = (rt->nmat - 2) / len - (min - 2) / len; i; --i) r = r->next;
+
+	/* older blocks hold the earlier slots, so their differences win */
+	top = (min - 2) % len + 1;
 
-	for (i = 0; i < min; ++i) {
-		cmp = ucmp(lt->mat[i].off, rt->mat[i].off);
-		if (cmp) return -cmp;
+	for (; l != r; l = l->next, r = r->next, top = len) {
+		for (i = 0; i < top; ++i) {
+			cmp = mat_cmp(l->mat + i, r->mat + i);
+			if (cmp) break;
+		}
 
-		cmp = ucmp(lt->mat[i].ext, rt->mat[i].ext);
-		if (cmp) return cmp;
+		if (cmp) ret = cmp;
 	}
 
-	return 0;
+	return ret;
+}
+
+void
+thr_drop(struct capture **cfl, struct thread *th)
+{
+	struct capture *cap = th->cap;
+	struct capture *tmp;
+
+	th->cap = 0x0;
+
+	while (cap && !--cap->ref) {
+		tmp = cap->next;
+		cap->next = *cfl;
+		*cfl = cap;
+		cap = tmp;
+	}
 }
 
 int
 thr_init(struct thread *th, struct ins *prog)
 {
 	th->ip = prog;
+	th->loop = 0x0;
+	th->cnt = 0;
 
 	th->nmat = 0;
 
@@ -57,8 +143,13 @@ void
 thr_fork(struct thread *dst, struct thread *src)
 {
 	dst->ip = src->ip;
+	dst->loop = src->loop;
+	dst->cnt = src->cnt;
 	dst->nmat = src->nmat;
-	memcpy(dst->mat, src->mat, sizeof dst->mat);
+	dst->mat = src->mat;
+
+	dst->cap = src->cap;
+	if (dst->cap) ++dst->cap->ref;
 }
 
 void
@@ -69,6 +160,56 @@ thr_free(struct thread *th)
 	while (th) a = th, th = a->next, free(a);
 }
 
+void
+thr_join(struct thread *dst[static 2], struct thread *th)
+{
+	while (th) thr_mv(dst, &th);
+}
+
+int
+thr_mark(struct capture **cfl, struct thread *th, size_t len, size_t pos)
+{
+	struct capture *cap;
+	size_t off;
+
+	if (!th->nmat) {
+		th->mat = (struct patmatch){ pos, -1 };
+		th->nmat = 1;
+		return 0;
+	}
+
+	off = (th->nmat - 1) % len;
+
+	if (!off) {
+		cap = cap_get(cfl, len);
+		if (!cap) return ENOMEM;
+
+		cap->next = th->cap;
+		cap->ref = 1;
+		th->cap = cap;
+	} else if (thr_own(cfl, th, th->nmat - 1)) return ENOMEM;
+
+	th->cap->mat[off] = (struct patmatch){ pos, -1 };
+	++th->nmat;
+
+	return 0;
+}
+
+struct patmatch *
+thr_match(struct thread *th, size_t i)
+{
+	struct capture *cap = th->cap;
+	size_t k;
+
+	if (!i) return &th->mat;
+
+	for (k = (th->nmat - 2) / cap->len - (i - 1) / cap->len; k; --k) {
+		cap = cap->next;
+	}
+
+	return cap->mat + (i - 1) % cap->len;
+}
+
 void
 thr_mv(struct thread *dst[static 2], struct thread **src)
 {
@@ -78,3 +219,69 @@ thr_mv(struct thread *dst[static 2], struct thread **src)
 	tmp->next = dst[0];
 	dst[0] = tmp;
 }
+
+int
+thr_own(struct capture **cfl, struct thread *th, size_t i)
+{
+	struct capture **at = &th->cap;
+	struct capture *cap;
+	struct capture *cpy;
+	size_t k;
+
+	/* copy every shared block from the newest down to slot i's */
+	for (k = (th->nmat - 2) / at[0]->len - (i - 1) / at[0]->len;; --k) {
+		cap = *at;
+
+		if (cap->ref > 1) {
+			cpy = cap_get(cfl, cap->len);
+			if (!cpy) return ENOMEM;
+
+			memcpy(cpy->mat, cap->mat, cap->len * sizeof *cap->mat);
+			cpy->next = cap->next;
+			cpy->ref = 1;
+			if (cpy->next) ++cpy->next->ref;
+
+			--cap->ref;
+			*at = cap = cpy;
+		}
+
+		if (!k) return 0;
+		at = &cap->next;
+	}
+}
+
+void
+thr_read(struct patmatch *dst, struct thread *th)
+{
+	struct capture *cap = th->cap;
+	size_t i;
+
+	if (!th->nmat) return;
+
+	dst[0] = th->mat;
+
+	for (i = th->nmat - 1; i; --i) {
+		dst[i] = cap->mat[(i - 1) % cap->len];
+		if ((i - 1) % cap->len == 0) cap = cap->next;
+	}
+}
+
+int
+thr_save(struct capture **cfl, struct thread *th, size_t pos)
+{
+	struct capture *cap = th->cap;
+	struct patmatch *mat;
+	size_t i;
+
+	for (i = th->nmat - 1; i; --i) {
+		if (cap->mat[(i - 1) % cap->len].ext == -1UL) break;
+		if ((i - 1) % cap->len == 0) cap = cap->next;
+	}
+
+	if (i && thr_own(cfl, th, i)) return ENOMEM;
+
+	mat = thr_match(th, i);
+	mat->ext = pos - mat->off;
+
+	return 0;
+}
@@ -5,48 +5,506 @@
 #include <string.h>
 #include <ctype.h>
 
+#include <util.h>
 #include <vec.h>
 
 #include <pat.h>
 #include <pat.ih>
 
+static int  compile(struct pattern *, char const *, int, struct arena *);
+static int  compile_size(char const *, int, size_t *);
+static int  execute(struct pattern *, struct patmatcher *, char const *, size_t, size_t, size_t);
+static void hot(struct pattern *);
+static int  vm_match(struct pattern *, struct patmatcher *, char const *, size_t, size_t, size_t);
+
+int
+execute(struct pattern *pat, struct patmatcher *pm, char const *buf, size_t len, size_t pos, size_t lim)
+{
+	struct patmatch mat;
+	size_t min = pat->plan->min;
+	int err;
+
+	/* too little text left for even the shortest match */
+	if (len - pos < min) return PAT_ERR_NOMATCH;
+
+	/* compiled into a buffer, a pattern left its dfa to be made now */
+	if (pat->placed && !pat->sft && !pat->dfa && pat->plan->find == PAT_DFA) {
+		err = dfa_alloc(&pat->dfa, pat->prog, prog_len(pat->prog));
+		if (err) return err;
+	}
+
+	if (!pat->sft && !pat->dfa) return vm_match(pat, pm, buf, len, pos, lim);
+
+	/* nor can one start any later than this */
+	lim = umin(lim, len - min + 1);
+
+	/* past a few runs, if asked to, shift-and gives way to a dfa compiled to machine code */
+	if (pat->jit && pat->sft && !pat->dfa && ++pat->runs == JIT_AFTER) hot(pat);
+
+	if (pat->dfa) err = dfa_match(pat, pat->dfa, buf + pos, len - pos, lim - pos);
+	else err = shift_match(pat, pat->sft, buf + pos, len - pos, lim - pos);
+
+	if (err) return err;
+
+	/* these only saw the text from pos on */
+	mat = pat->mat[0];
+	mat.off += pos;
+	pat->mat[0] = mat;
+
+	if (!pat->nsub) return 0;
+
+	/* the match is found; submatches only need the vm over its span */
+	if (pat->one) return one_match(pat, pat->one, buf, mat.off, mat.off + mat.ext);
+
+	/* a short span with a single way through needs no threads either */
+	err = back_match(pat, buf, mat.off, mat.off + mat.ext);
+	if (err != ENOTSUP) return err;
+
+	return vm_match(pat, pm, buf, mat.off + mat.ext, mat.off, -1);
+}
+
+void
+hot(struct pattern *pat)
+{
+	/* a cached pattern's engines belong to its entry, and other copies may have got there first */
+	struct pattern *own = pat->ent ? pat->ent->pat : pat;
+
+	/* where there is no compiling, shift-and goes on */
+	if (!own->dfa) dfa_jit_alloc(&own->dfa, pat);
+
+	pat->dfa = own->dfa;
+}
+
+int
+vm_match(struct pattern *pat, struct patmatcher *pm, char const *buf, size_t len, size_t pos, size_t lim)
+{
+	/* started part way in, the vm still counts from buf */
+	struct context ctx[1] = {{
+		.str = buf + pos,
+		.len = len - pos,
+		.off = pos,
+		.pos = pos,
+		.lim = lim,
+		.pm  = pm,
+	}};
+
+	return pat_match(pat, ctx);
+}
+
 int
 pat_compile(struct pattern *dst, char const *src)
+{
+	return pat_compile_flags(dst, src, 0);
+}
+
+int
+pat_compile_flags(struct pattern *dst, char const *src, int flags)
+{
+	if (!dst) return EFAULT;
+	if (!src) return EFAULT;
+
+	return compile(dst, src, flags, 0x0);
+}
+
+int
+pat_compile_buf(struct pattern *dst, char const *src, int flags, void *buf, size_t *len)
+{
+	struct arena ar[1];
+	int err;
+
+	if (!dst) return EFAULT;
+	if (!src) return EFAULT;
+	if (!len) return EFAULT;
+
+	if (!buf) return compile_size(src, flags, len);
+
+	arena_init(ar, buf, *len);
+
+	/* nothing comes from the heap, so running out is the buffer being too small */
+	err = compile(dst, src, flags, ar);
+	if (err == ENOMEM) {
+		err = compile_size(src, flags, len);
+		return err ? err : ERANGE;
+	}
+	if (err) return err;
+
+	*len = ar->skip + ar->lo;
+
+	return 0;
+}
+
+int
+compile_size(char const *src, int flags, size_t *len)
+{
+	struct pattern pat[1];
+	struct arena ar[1];
+	int err;
+
+	/* once through on the heap, counting what a buffer would have given */
+	arena_count(ar);
+	err = compile(pat, src, flags, ar);
+	if (!err) pat_free(pat);
+	arena_fini(ar);
+	if (err) return err;
+
+	/* room to align wherever the buffer starts */
+	*len = ar->peak + AR_ALIGN - 1;
+
+	return 0;
+}
+
+int
+compile(struct pattern *dst, char const *src, int flags, struct arena *ar)
 {
 	struct token *tok = 0;
 	int err = 0;
 
+	dst->mat = 0x0;
+	dst->prog = 0x0;
+	dst->dfa = 0x0;
+	dst->pre = 0x0;
+	dst->sft = 0x0;
+	dst->one = 0x0;
+	dst->plan = 0x0;
+	dst->ent = 0x0;
+	dst->runs = 0;
+	dst->jit = flags & PAT_JIT;
+	dst->mapped = false;
+	dst->placed = ar != 0x0;
+	dst->spilled = false;
+
+	err = pat_parse(&tok, src, ar);
+	if (err) goto finally;
+
+	dst->nsub = tok_nsub(tok);
+	dst->msiz = dst->nsub + 1;
+
+	dst->mat = arena_keep(ar, dst->msiz, sizeof *dst->mat);
+	if (!dst->mat) {
+		err = ENOMEM;
+		goto finally;
+	}
+
+	err = pat_marshal(dst, tok, ar);
+	if (err) goto finally;
+
+	/* the tokens are done with, and only the program is read from here on */
+	tok_free(tok, ar);
+	tok = 0x0;
+
+	err = pat_anchor(dst, flags, ar);
+	if (err) goto finally;
+
+	err = pat_prefix(dst, ar);
+	if (err) goto finally;
+
+	err = pat_plan(dst, ar);
+
+finally:
+	if (err) {
+		pat_free(dst);
+		memset(dst, 0, sizeof *dst);
+	}
+
+	tok_free(tok, ar);
+	return err;
+
+}
+
+int
+pat_set_compile(struct patset *dst, char const **src, size_t npat)
+{
+	struct pattern tmp[1];
+	struct token *tok = 0x0;
+	struct ins **progs = 0x0;
+	size_t len;
+	size_t i;
+	int err = 0;
+
 	if (!dst) return EFAULT;
 	if (!src) return EFAULT;
+	if (!npat) return EINVAL;
+
+	*dst = (struct patset){ .npat = npat };
+
+	progs = calloc(npat, sizeof *progs);
+	if (!progs) return ENOMEM;
+
+	for (i = 0; i < npat; ++i) {
+		err = pat_parse(&tok, src[i], 0x0);
+		if (err) goto finally;
+
+		err = pat_marshal(tmp, tok, 0x0);
+		if (err) goto finally;
 
-	err = pat_parse(&tok, src);
+		progs[i] = tmp->prog;
+
+		/* a set only ever runs on the dfa */
+		len = prog_len(tmp->prog);
+		if (prog_vm(tmp->prog, len)) {
+			err = ENOTSUP;
+			goto finally;
+		}
+
+		tok_free(tok, 0x0);
+		tok = 0x0;
+	}
+
+	err = pat_merge(&dst->prog, &len, progs, npat);
 	if (err) goto finally;
 
-	err = pat_marshal(dst, tok);
+	err = dfa_alloc(&dst->dfa, dst->prog, len);
 	if (err) goto finally;
 
+	dst->mat = calloc(npat, sizeof *dst->mat);
+	dst->hit = calloc((npat + 7) / 8, sizeof *dst->hit);
+	if (!dst->mat || !dst->hit) err = ENOMEM;
+
 finally:
-	tok_free(tok);
+	if (err) pat_set_free(dst);
+
+	tok_free(tok, 0x0);
+	for (i = 0; i < npat; ++i) free(progs[i]);
+	free(progs);
+
 	return err;
+}
+
+int
+pat_set_execute(struct patset *set, char const *str)
+{
+	if (!str) return EFAULT;
 
+	return pat_set_execute_n(set, str, strlen(str));
+}
+
+int
+pat_set_execute_n(struct patset *set, char const *buf, size_t len)
+{
+	if (!set) return EFAULT;
+	if (!buf) return EFAULT;
+
+	return dfa_set_match(set, set->dfa, buf, len);
+}
+
+void
+pat_set_free(struct patset *set)
+{
+	dfa_free(set->dfa);
+	free(set->prog);
+	free(set->mat);
+	free(set->hit);
+	set->dfa = 0x0;
+	set->prog = 0x0;
+	set->mat = 0x0;
+	set->hit = 0x0;
+}
+
+struct patmatcher *
+pat_matcher_alloc(void)
+{
+	return calloc(1, sizeof (struct patmatcher));
+}
+
+void
+pat_matcher_free(struct patmatcher *pm)
+{
+	if (!pm) return;
+	thr_free(pm->frl[0]);
+	cap_free(pm->cfl);
+	free(pm->vis);
+	free(pm);
+}
+
+int
+pat_begin(struct patstream **dst, struct pattern *pat)
+{
+	struct patstream *ps;
+	int err = 0;
+
+	if (!dst) return EFAULT;
+	if (!pat) return EFAULT;
+
+	ps = calloc(1, sizeof *ps);
+	if (!ps) return ENOMEM;
+
+	ps->pat = pat;
+
+	err = ctx_init(ps->ctx, pat);
+	if (err) goto fail;
+
+	*dst = ps;
+	return 0;
+
+fail:
+	free(ps);
+	return err;
+}
+
+int
+pat_feed(struct patstream *ps, char const *buf, size_t len)
+{
+	if (!ps) return EFAULT;
+	if (!buf) return EFAULT;
+
+	ps->ctx->str = buf;
+	ps->ctx->len = len;
+	ps->ctx->off = ps->ctx->pos;
+
+	return pat_exec(ps->ctx);
+}
+
+int
+pat_finish(struct patstream *ps)
+{
+	int err;
+
+	if (!ps) return EFAULT;
+
+	err = pat_end(ps->pat, ps->ctx);
+	free(ps);
+
+	return err;
 }
 
 void
 pat_free(struct pattern *pat)
 {
-	free(pat->prog);
+	struct patentry *ent = pat->ent;
+
+	/* all but what running it added lies in the caller's buffer */
+	if (pat->placed) {
+		if (pat->spilled) free(pat->mat);
+		dfa_free(pat->dfa);
+		return;
+	}
+
+	/* patterns from a cache share its entry's program, not their matches */
+	free(pat->mat);
+	if (ent && --ent->ref) return;
+	if (ent) pat = ent->pat;
+	if (ent) free(pat->mat);
+
+	dfa_free(pat->dfa);
+	shift_free(pat->sft);
+	one_free(pat->one);
+	free(pat->plan);
+	free(pat->pre);
+	if (!pat->mapped) free(pat->prog);
+	free(ent);
+}
+
+int
+pat_explain(struct pattern *pat, struct patplan *dst)
+{
+	if (!pat) return EFAULT;
+	if (!dst) return EFAULT;
+
+	*dst = *pat->plan;
+	dst->jit = pat->dfa && dfa_compiled(pat->dfa);
+
+	return 0;
 }
 
 int
 pat_execute(struct pattern *pat, char const *str)
+{
+	return pat_execute_with(pat, 0x0, str);
+}
+
+int
+pat_execute_n(struct pattern *pat, char const *buf, size_t len)
+{
+	if (!buf) return EFAULT;
+	if (!pat) return EFAULT;
+
+	return execute(pat, 0x0, buf, len, 0, -1);
+}
+
+int
+pat_execute_with(struct pattern *pat, struct patmatcher *pm, char const *str)
 {
 	if (!str) return EFAULT;
 	if (!pat) return EFAULT;
 
-	struct context ctx[1] = {{
-		.str = str,
-		.len = strlen(str),
-	}};
+	return execute(pat, pm, str, strlen(str), 0, -1);
+}
 
-	return pat_match(pat, ctx);
+int
+pat_iter_init(struct patiter *it, struct pattern *pat, char const *buf, size_t len)
+{
+	struct ins *ip;
+
+	if (!it) return EFAULT;
+	if (!pat) return EFAULT;
+	if (!buf) return EFAULT;
+
+	*it = (struct patiter){
+		.str  = buf,
+		.len  = len,
+		.last = -1,
+		.pat  = pat,
+	};
+
+	for (ip = pat->prog; ip->op != op_halt; ++ip) it->bol |= ip->op == op_bol;
+
+	it->pm = pat_matcher_alloc();
+	if (!it->pm) return ENOMEM;
+
+	return 0;
+}
+
+void
+pat_iter_fini(struct patiter *it)
+{
+	pat_matcher_free(it->pm);
+	it->pm = 0x0;
+}
+
+int
+iter_next(struct patiter *it, struct patmatch *dst, size_t lim)
+{
+	struct patmatch *mat;
+	int err;
+
+	while (it->pos <= it->len && it->pos < lim) {
+		/* past the start only the vm knows a ^ cannot hold */
+		if (it->pos && it->bol) {
+			err = vm_match(it->pat, it->pm, it->str, it->len, it->pos, lim);
+		} else err = execute(it->pat, it->pm, it->str, it->len, it->pos, lim);
+
+		if (err == PAT_ERR_NOMATCH) break;
+		if (err) return err;
+
+		mat = it->pat->mat;
+
+		/*
+		 * an empty match right where the last one ended is skipped; after
+		 * an empty match move on a byte, since a longer one would have won
+		 */
+		if (mat->ext || mat->off != it->last) {
+			it->last = mat->off + mat->ext;
+			it->pos = it->last + !mat->ext;
+			*dst = *mat;
+			return 0;
+		}
+
+		it->pos = mat->off + 1;
+	}
+
+	return PAT_ERR_NOMATCH;
+}
+
+int
+pat_next(struct patiter *it, struct patmatch *dst)
+{
+	int err;
+
+	if (!it) return EFAULT;
+	if (!dst) return EFAULT;
+
+	err = iter_next(it, dst, -1);
+	if (err == PAT_ERR_NOMATCH) it->pos = it->len + 1;
+
+	return err;
 }
@@ -8,7 +8,24 @@
 enum {
 	PAT_ERR_NOMATCH  = -1,
 	PAT_ERR_BADPAREN = -2,
-	PAT_ERR_BADREP   = -3
+	PAT_ERR_BADREP   = -3,
+	PAT_ERR_BADCLASS = -4,
+};
+
+/* PAT_JIT lets a search run often enough be compiled to machine code */
+enum {
+	PAT_ANCHORED = 1 << 0,
+	PAT_JIT      = 1 << 1,
+};
+
+/* the engines pat_compile picks from; pat_engine names them */
+enum patengine {
+	PAT_NONE,
+	PAT_VM,
+	PAT_SHIFT,
+	PAT_DFA,
+	PAT_ONEPASS,
+	PAT_BACKTRACK,
 };
 
 struct patmatch {
@@ -16,14 +33,116 @@ struct patmatch {
 	size_t ext;
 };
 
+/*
+ * what pat_compile found out about a pattern and the engines it picked:
+ * one to find each match and one to fill in its submatches, the
+ * backtracker only over spans up to back bytes and otherwise the vm;
+ * max is -1 when no bound was found, and jit is set once a pattern run
+ * often enough finds its matches with machine code
+ */
+struct patplan {
+	size_t         min;
+	size_t         max;
+	size_t         nsub;
+	bool           anchored;
+	bool           onepass;
+	size_t         npre;
+	size_t         nsuf;
+	char const    *pre;
+	char const    *suf;
+	enum patengine find;
+	enum patengine sub;
+	size_t         back;
+	bool           jit;
+};
+
 struct pattern {
 	size_t nmat;
-	struct patmatch  mat[10];
+	size_t nsub;
+	size_t msiz;
+	struct patmatch *mat;
 	struct ins      *prog;
+	struct dfa      *dfa;
+	struct prefix   *pre;
+	struct shift    *sft;
+	struct onepass  *one;
+	struct patplan  *plan;
+	struct patentry *ent;
+	size_t           runs;
+	bool             jit;
+	bool             mapped;
+	bool             placed;
+	bool             spilled;
+};
+
+struct patset {
+	size_t       npat;
+	size_t       nmat;
+	size_t      *mat;
+	uint8_t     *hit;
+	struct ins  *prog;
+	struct dfa  *dfa;
+};
+
+/* walks the matches in a buffer left to right, see pat_next */
+struct patiter {
+	char const        *str;
+	size_t             len;
+	size_t             pos;
+	size_t             last;
+	bool               bol;
+	struct pattern    *pat;
+	struct patmatcher *pm;
 };
 
+struct patcache;
+struct patmatcher;
+struct patstream;
+
 int  pat_compile(struct pattern *, char const *);
+int  pat_compile_flags(struct pattern *, char const *, int);
 int  pat_execute(struct pattern *, char const *);
+int  pat_execute_with(struct pattern *, struct patmatcher *, char const *);
+int  pat_execute_n(struct pattern *, char const *, size_t);
+int  pat_explain(struct pattern *, struct patplan *);
+char const *pat_engine(enum patengine);
 void pat_free(struct pattern *);
 
+/*
+ * compiles into a buffer, e.g. on the stack, without allocating; no
+ * buffer, or too small a one, asks for the size, and once compiled the
+ * size is what the pattern keeps of it, the rest free to reuse; the
+ * buffer has to last as long as the pattern, and pat_free still frees
+ * what running it adds
+ */
+int  pat_compile_buf(struct pattern *, char const *, int, void *, size_t *);
+
+/* a program as bytes pat_load can run in place, e.g. from mmap; no buffer asks for the size */
+int  pat_dump(struct pattern *, void *, size_t *);
+int  pat_load(struct pattern *, void const *, size_t);
+
+int  pat_set_compile(struct patset *, char const **, size_t);
+int  pat_set_execute(struct patset *, char const *);
+int  pat_set_execute_n(struct patset *, char const *, size_t);
+void pat_set_free(struct patset *);
+
+struct patmatcher *pat_matcher_alloc(void);
+void               pat_matcher_free(struct patmatcher *);
+
+struct patcache *pat_cache_alloc(size_t);
+void             pat_cache_free(struct patcache *);
+int              pat_cache_compile(struct patcache *, struct pattern *, char const *);
+
+int pat_begin(struct patstream **, struct pattern *);
+int pat_feed(struct patstream *, char const *, size_t);
+int pat_finish(struct patstream *);
+
+int  pat_iter_init(struct patiter *, struct pattern *, char const *, size_t);
+void pat_iter_fini(struct patiter *);
+int  pat_next(struct patiter *, struct patmatch *);
+
+/* what pat_next finds, split over threads; 0 threads is one per cpu */
+int pat_count(struct pattern *, char const *, size_t, size_t, size_t *);
+int pat_scan(struct pattern *, char const *, size_t, size_t, struct patmatch **, size_t *);
+
 #endif // _lib_pat_
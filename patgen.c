@@ -0,0 +1,91 @@
+#include <ctype.h>
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <util.h>
+#include <pat.h>
+#include <pat.ih>
+
+/*
+ * patgen [file]: reads lines of a c name and a pattern after it, and
+ * writes a function by that name for each, matching like pat_execute
+ * but without compiling anything at run time:
+ *
+ *	int name(char const *buf, size_t len, struct patmatch *mat);
+ *
+ * it only fills in the whole match; blank lines and lines starting
+ * with # are skipped
+ */
+
+static char *name_end(char *);
+
+char *
+name_end(char *ln)
+{
+	if (!isalpha((uint8_t)*ln) && *ln != '_') return 0x0;
+
+	while (isalnum((uint8_t)*ln) || *ln == '_') ++ln;
+
+	return *ln == ' ' || *ln == '\t' ? ln : 0x0;
+}
+
+int
+main(int argc, char **argv)
+{
+	char const *path = argc > 1 ? argv[1] : "-";
+	FILE *src = stdin;
+	char ln[4096];
+	char *end;
+	char *pat;
+	size_t lno = 0;
+	int err;
+
+	if (argc > 2) {
+		fprintf(stderr, "usage: patgen [file]\n");
+		return 1;
+	}
+
+	if (strcmp(path, "-")) src = fopen(path, "r");
+	if (!src) die(path);
+
+	printf("/* made by patgen from %s */\n", path);
+	printf("#include <stddef.h>\n#include <string.h>\n\n#include <pat.h>\n\n");
+
+	while (fgets(ln, sizeof ln, src)) {
+		++lno;
+
+		end = strchr(ln, '\n');
+		if (!end && !feof(src)) {
+			fprintf(stderr, "%s:%zu: line too long\n", path, lno);
+			return 1;
+		}
+		if (end) *end = 0;
+
+		if (!*ln || *ln == '#') continue;
+
+		end = name_end(ln);
+		if (!end) {
+			fprintf(stderr, "%s:%zu: expected a name, then a pattern\n", path, lno);
+			return 1;
+		}
+
+		*end++ = 0;
+		for (pat = end; *pat == ' ' || *pat == '\t'; ++pat) continue;
+
+		err = gen_match(stdout, ln, pat);
+		if (err == ENOTSUP) {
+			fprintf(stderr, "%s:%zu: '%s' needs the vm, or too many states\n", path, lno, pat);
+			return 1;
+		}
+		if (err) {
+			fprintf(stderr, "%s:%zu: '%s' does not compile (%d)\n", path, lno, pat, err);
+			return 1;
+		}
+	}
+
+	if (ferror(src)) die(path);
+	if (fflush(stdout)) die("patgen");
+
+	return 0;
+}
@@ -46,7 +46,6 @@ static size_t              nod_compare(struct external *, struct key *);
 static int                 nod_init(struct internal *, struct key *, struct external *);
 static int                 nod_insert(uintptr_t *, struct internal *, struct key *);
 static void                nod_freetree(uintptr_t);
-static uintptr_t           nod_locate(uintptr_t *, struct key *);
 static bool                nod_match(struct internal *, struct key *);
 static size_t              nod_popcount(uintptr_t);
 static uintptr_t           nod_scan(uintptr_t, struct key *);
@@ -199,25 +198,6 @@ nod_freetree(uintptr_t cur)
 	free(nod);
 }
 
-uintptr_t
-nod_locate(uintptr_t *prev, struct key *key)
-{
-	int8_t bit = 0;
-	struct internal *nod = 0x0;
-	uintptr_t cur = *prev;
-	uintptr_t next = cur;
-
-	while (isnode(next)) {
-		*prev = cur;
-		 cur  = next;
-		 nod  = node(cur);
-		 bit  = key_index(key, nod->crit);
-		 next = nod->chld[bit];
-	}
-
-	return cur;
-}
-
 bool
 nod_match(struct internal *nod, struct key *key)
 {
@@ -392,34 +372,28 @@ int
 set_do_remove(uintptr_t *dst, struct key *key)
 {
 	struct internal *nod = 0x0;
-	struct external *ex = 0x0;
-	uintptr_t loc = 0;
-	uintptr_t src = 0;
+	uintptr_t *up = 0x0;
 	uint8_t bit = 0;
 
-	loc = nod_locate(dst, key);
-
-	if (isleaf(*dst)) ex = leaf(*dst);
-	else nod = node(*dst);
-
-	if (isnode(loc)) nod = node(loc);
+	/* down to the leaf, remembering where its parent hangs */
+	while (isnode(*dst)) {
+		up = dst;
+		nod = node(*dst);
+		bit = key_index(key, nod->crit);
+		dst = nod->chld + bit;
+	}
 
-	if (!ex) ex = leaf(nod->chld[key_index(key, nod->crit)]);
+	if (!key_match(key, leaf(*dst))) return ENOENT;
 
-	if (!key_match(key, ex)) return ENOENT;
+	free(leaf(*dst));
 
-	if (!nod) *dst = 0x0;
-	else if (*dst == loc) {
-		 bit = nod->chld[1] == tag_leaf(ex);
-		*dst = nod->chld[!bit];
-	} else {
-		bit = nod->chld[1] == tag_leaf(ex);
-		src = nod->chld[!bit];
-		bit = node(*dst)->chld[1] == loc;
-		node(*dst)->chld[bit] = src;
+	if (!up) {
+		*dst = 0;
+		return 0;
 	}
 
-	free(ex);
+	/* the leaf's sibling takes its parent's place */
+	*up = nod->chld[!bit];
 	free(nod);
 
 	return 0;
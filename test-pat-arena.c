@@ -0,0 +1,209 @@
+#include <unit.h>
+#include <util.h>
+#include <pat-arena.c>
+
+char unit_filename[] = "pat-arena.c";
+
+static void cleanup();
+static void test_back();
+static void test_compile();
+static void test_count();
+static void test_grow();
+static void test_size();
+
+struct test unit_tests[] = {
+	{ "handing out both ends",         0x0, test_back,    cleanup, },
+	{ "counting without a buffer",     0x0, test_count,   cleanup, },
+	{ "asking how big a buffer",       0x0, test_size,    cleanup, },
+	{ "matching like pat_compile",     0x0, test_compile, cleanup, },
+	{ "growing out of the buffer",     0x0, test_grow,    cleanup, },
+	{ 0x0 },
+};
+
+char const *src[] = {
+	"hello",
+	"^(GET|POST) (/[a-z.]*)",
+	"(a|ab)(c|bcd)(d*)",
+	"x[0-9]{2,4}y",
+	"(ab){300}$",
+	"[ab]*a[ab]{8}",
+	"(a*)*b",
+};
+
+char const *txt[] = {
+	"oh hello there",
+	"GET /index.html HTTP/1.1",
+	"xxabcdddd",
+	"x123y x12345y",
+	"",
+	"bbbabbbbbbbbb",
+	"aaab",
+};
+
+uint64_t mem[4096];
+struct pattern pat[1];
+struct pattern ref[1];
+
+void
+cleanup()
+{
+	if (pat->prog) pat_free(pat);
+	if (ref->prog) pat_free(ref);
+
+	memset(pat, 0, sizeof *pat);
+	memset(ref, 0, sizeof *ref);
+}
+
+void
+test_back()
+{
+	struct arena ar[1];
+	uint8_t *kept;
+	uint8_t *a;
+	uint8_t *b;
+
+	arena_init(ar, mem, 1024);
+
+	kept = arena_keep(ar, 3, 1);
+	ok(kept == (uint8_t *)mem);
+	expect(AR_ALIGN, ar->lo);
+
+	a = arena_temp(ar, 100, 1);
+	b = arena_temp(ar, 100, 1);
+	ok(b < a);
+	ok(a + 100 <= (uint8_t *)mem + 1024);
+	expect(2 * (AR_HEAD + 112), ar->hi);
+
+	/* given back out of turn, a block waits for those after it */
+	arena_free(ar, a);
+	expect(2 * (AR_HEAD + 112), ar->hi);
+	arena_free(ar, b);
+	expect(0, ar->hi);
+	expect(AR_ALIGN + 2 * (AR_HEAD + 112), ar->peak);
+
+	/* kept blocks stay, and what does not fit is refused */
+	arena_free(ar, kept);
+	expect(AR_ALIGN, ar->lo);
+	ok(arena_keep(ar, 1024, 1) == 0x0);
+	ok(arena_temp(ar, 1000, 1) == 0x0);
+	ok(arena_keep(ar, -1, 2) == 0x0);
+
+	/* a buffer off the alignment starts at the next step */
+	arena_init(ar, (uint8_t *)mem + 1, 1024);
+	expect(AR_ALIGN - 1, ar->skip);
+	ok(arena_keep(ar, 1, 1) == (uint8_t *)mem + AR_ALIGN);
+}
+
+void
+test_count()
+{
+	struct arena ar[1];
+	uint8_t *kept;
+	uint8_t *a;
+	uint8_t *b;
+
+	arena_count(ar);
+
+	/* the same sizes as a buffer, from blocks of the heap */
+	kept = arena_keep(ar, 3, 1);
+	ok(kept != 0x0);
+	expect(AR_ALIGN, ar->lo);
+
+	a = arena_temp(ar, 100, 1);
+	b = arena_temp(ar, 100, 1);
+	ok(a && b);
+	memset(a, 1, 100);
+	memset(b, 1, 100);
+	expect(2 * (AR_HEAD + 112), ar->hi);
+
+	arena_free(ar, a);
+	expect(2 * (AR_HEAD + 112), ar->hi);
+	arena_free(ar, kept);
+	arena_free(ar, b);
+	expect(0, ar->hi);
+	expect(AR_ALIGN, ar->lo);
+	expect(AR_ALIGN + 2 * (AR_HEAD + 112), ar->peak);
+
+	/* what is still out goes with the arena */
+	ok(arena_temp(ar, 10, 1) != 0x0);
+	arena_fini(ar);
+}
+
+void
+test_size()
+{
+	size_t len;
+	size_t need;
+	size_t i;
+
+	for (i = 0; i < array_len(src); ++i) {
+		expect(0, pat_compile_buf(pat, src[i], 0, 0x0, &need));
+		ok(need > 0);
+
+		/* just enough, wherever the buffer starts */
+		len = need;
+		expectf(0, pat_compile_buf(pat, src[i], 0, (uint8_t *)mem + i, &len), "'%s' in %zu bytes", src[i], need);
+		ok(len <= need);
+		pat_free(pat);
+
+		/* too little says how much */
+		len = need / 2;
+		expect(ERANGE, pat_compile_buf(pat, src[i], 0, mem, &len));
+		expect(need, len);
+	}
+
+	len = sizeof mem;
+	expect(PAT_ERR_BADPAREN, pat_compile_buf(pat, "(ab", 0, mem, &len));
+	expect(EFAULT, pat_compile_buf(pat, "ab", 0, mem, 0x0));
+	memset(pat, 0, sizeof *pat);
+}
+
+void
+test_compile()
+{
+	struct patplan want;
+	struct patplan got;
+	size_t len;
+	size_t i;
+	size_t j;
+	size_t k;
+
+	for (i = 0; i < array_len(src); ++i) {
+		len = sizeof mem;
+		try(pat_compile_buf(pat, src[i], 0, mem, &len));
+		try(pat_compile(ref, src[i]));
+
+		expect(0, pat_explain(ref, &want));
+		expect(0, pat_explain(pat, &got));
+		expect(want.find, got.find);
+		expect(want.sub, got.sub);
+
+		/* long enough for a search to turn hot */
+		for (k = 0; k < JIT_AFTER * 2; ++k) for (j = 0; j < array_len(txt); ++j) {
+			expectf(pat_execute(ref, txt[j]), pat_execute(pat, txt[j]), "'%s' on '%s'", src[i], txt[j]);
+			if (ref->nmat != pat->nmat) continue;
+			ok(!memcmp(ref->mat, pat->mat, ref->nmat * sizeof *ref->mat));
+		}
+
+		pat_free(pat);
+		pat_free(ref);
+		memset(pat, 0, sizeof *pat);
+		memset(ref, 0, sizeof *ref);
+	}
+}
+
+void
+test_grow()
+{
+	size_t len = sizeof mem;
+
+	/* each time round the group is another submatch */
+	try(pat_compile_buf(pat, "((a)|b)+$", 0, mem, &len));
+	ok(pat->mat >= (struct patmatch *)mem);
+
+	expect(0, pat_execute(pat, "abababababababababab"));
+	expect(true, pat->spilled);
+	ok(pat->mat < (struct patmatch *)mem || pat->mat >= (struct patmatch *)(mem + array_len(mem)));
+	expect(0, pat->mat[0].off);
+	expect(20, pat->mat[0].ext);
+}
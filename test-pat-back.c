@@ -0,0 +1,62 @@
+#include <unit.h>
+#include <util.h>
+#include <pat-back.c>
+
+char unit_filename[] = "pat-back.c";
+
+static void cleanup();
+static void test_fallback();
+static void test_high();
+
+struct test unit_tests[] = {
+	{ "handing ambiguous spans back", 0x0, test_fallback, cleanup, },
+	{ "matching bytes past ascii",    0x0, test_high,     cleanup, },
+	{ 0x0 },
+};
+
+struct pattern pat[1];
+
+void
+cleanup()
+{
+	try(pat_free(pat));
+	memset(pat, 0, sizeof *pat);
+}
+
+void
+test_fallback()
+{
+	char buf[BACK_MAX];
+
+	try(pat_compile(pat, "(a*)(a*)"));
+	expect(ENOTSUP, back_match(pat, "aaa", 0, 3));
+	try(pat_free(pat));
+
+	try(pat_compile(pat, "(a*)*b"));
+	expect(ENOTSUP, back_match(pat, "aab", 0, 3));
+	try(pat_free(pat));
+
+	memset(buf, 'a', sizeof buf);
+
+	try(pat_compile(pat, "(a|b)*"));
+	expect(0, back_match(pat, buf, 0, 8));
+	expect(ENOTSUP, back_match(pat, buf, 0, sizeof buf));
+	try(pat_free(pat));
+
+	memset(pat, 0, sizeof *pat);
+}
+
+void
+test_high()
+{
+	struct patmatch want[] = { { 1, 3 }, { 1, 2 }, { 3, 1 } };
+
+	try(pat_compile(pat, "(\xe9|\xe9" "b)(c|bcd)"));
+
+	expect(0, back_match(pat, "x\xe9" "bc", 1, 4));
+	expect(3, pat->nmat);
+	expect(0, memcmp(want, pat->mat, sizeof want));
+
+	expect(0, pat_execute(pat, "x\xe9" "bc"));
+	expect(0, memcmp(want, pat->mat, sizeof want));
+}
@@ -0,0 +1,127 @@
+#include <unit.h>
+#include <pat-cache.c>
+
+char unit_filename[] = "pat-cache.c";
+
+static void setup(char *);
+static void cleanup();
+static void test_churn();
+static void test_evict();
+static void test_outlive();
+static void test_share();
+
+struct test unit_tests[] = {
+	{ "sharing a compiled pattern",      setup, test_share,   cleanup, "a(b|c)*d", },
+	{ "evicting the least recently used", setup, test_evict,  cleanup, "abc", },
+	{ "outliving the cache",             setup, test_outlive, cleanup, "x+y", },
+	{ "evicting over and over",          setup, test_churn,   cleanup, "x+y", },
+	{ 0x0 },
+};
+
+struct patcache *pc;
+struct pattern pat[2];
+
+void
+setup(char *src)
+{
+	pc = pat_cache_alloc(2);
+	ok(pc != 0x0);
+
+	try(pat_cache_compile(pc, pat, src));
+}
+
+void
+cleanup()
+{
+	try(pat_free(pat));
+	try(pat_free(pat + 1));
+	try(pat_cache_free(pc));
+	memset(pat, 0, sizeof pat);
+	pc = 0x0;
+}
+
+void
+test_share()
+{
+	try(pat_cache_compile(pc, pat + 1, "a(b|c)*d"));
+
+	ok(pat[0].prog == pat[1].prog);
+	expect(3, pat[0].ent->ref);
+	expect(1, pc->len);
+
+	expect(0, pat_execute(pat, "xabcbd"));
+	expect(-1, pat_execute(pat + 1, "xabcb"));
+
+	expect(1, pat[0].mat[0].off);
+	expect(5, pat[0].mat[0].ext);
+}
+
+void
+test_evict()
+{
+	struct pattern tmp[1];
+
+	try(pat_cache_compile(pc, tmp, "def"));
+	try(pat_free(tmp));
+
+	try(pat_cache_compile(pc, tmp, "abc"));
+	try(pat_free(tmp));
+
+	try(pat_cache_compile(pc, tmp, "ghi"));
+	try(pat_free(tmp));
+
+	expect(2, pc->len);
+	ok(cache_find(pc, "abc") != 0x0);
+	ok(cache_find(pc, "def") == 0x0);
+	ok(cache_find(pc, "ghi") != 0x0);
+
+	try(pat_cache_compile(pc, pat + 1, "def"));
+	expect(2, pc->len);
+	ok(cache_find(pc, "abc") == 0x0);
+	ok(cache_find(pc, "def") != 0x0);
+
+	expect(1, pat[0].ent->ref);
+	expect(0, pat_execute(pat, "abc"));
+}
+
+void
+test_outlive()
+{
+	try(pat_cache_free(pc));
+	pc = 0x0;
+
+	expect(1, pat->ent->ref);
+	expect(0, pat_execute(pat, "xxxy"));
+	expect(4, pat->mat[0].ext);
+
+	pc = pat_cache_alloc(2);
+	ok(pc != 0x0);
+}
+
+void
+test_churn()
+{
+	struct patentry *ent;
+	struct pattern tmp[1];
+	char src[16];
+	size_t i;
+
+	try(pat_cache_free(pc));
+	pc = pat_cache_alloc(8);
+	ok(pc != 0x0);
+
+	/* more sources than fit, so nearly every compile evicts */
+	for (i = 0; i < 2000; ++i) {
+		sprintf(src, "x%zuy", i % 12);
+		expect(0, pat_cache_compile(pc, tmp, src));
+		ok(cache_find(pc, src) == tmp->ent);
+		try(pat_free(tmp));
+	}
+
+	expect(8, pc->len);
+	expect(8, set_query(0x0, 0, pc->set, (void *)"x", 1));
+
+	for (ent = pc->head; ent; ent = ent->next) {
+		ok(cache_find(pc, (char const *)ent->key) == ent);
+	}
+}
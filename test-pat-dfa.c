@@ -0,0 +1,54 @@
+#include <unit.h>
+#include <pat-dfa.c>
+
+char unit_filename[] = "pat-dfa.c";
+
+static void setup(char *);
+static void cleanup();
+static void test_flush();
+
+struct test unit_tests[] = {
+	{ "flushing the state cache",   setup, test_flush, cleanup, "a.........e", },
+	{ 0x0 },
+};
+
+struct pattern pat[1];
+char txt[4096];
+
+void
+setup(char *src)
+{
+	try(pat_compile(pat, src));
+
+	/* short patterns go to the shift-and engine; use the dfa anyway */
+	shift_free(pat->sft);
+	pat->sft = 0x0;
+	try(dfa_alloc(&pat->dfa, pat->prog, prog_len(pat->prog)));
+	ok(pat->dfa != 0x0);
+}
+
+void
+cleanup()
+{
+	try(pat_free(pat));
+	memset(pat, 0, sizeof *pat);
+}
+
+void
+test_flush()
+{
+	struct context ctx[1] = {{ .str = txt, .len = sizeof txt - 1 }};
+	unsigned long r = 1;
+	size_t i;
+
+	/* never a match, but enough different states to fill the cache */
+	for (i = 0; i < sizeof txt - 1; ++i) {
+		r = r * 1103515245 + 12345;
+		txt[i] = "abcd"[r >> 16 & 3];
+	}
+
+	expect(-1, pat_execute(pat, txt));
+	ok(pat->dfa->fwd->nflush > 0);
+
+	expect(-1, pat_match(pat, ctx));
+}
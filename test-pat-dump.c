@@ -0,0 +1,283 @@
+#include <stdio.h>
+#include <sys/mman.h>
+#include <unit.h>
+#include <util.h>
+#include <pat-dump.c>
+
+char unit_filename[] = "pat-dump.c";
+
+static void cleanup();
+static void test_bounds();
+static void test_damage();
+static void test_escape();
+static void test_mmap();
+static void test_reject();
+static void test_roundtrip();
+
+struct test unit_tests[] = {
+	{ "matching the same once loaded", 0x0, test_roundtrip, cleanup, },
+	{ "running from a mapped file",    0x0, test_mmap,      cleanup, },
+	{ "refusing bad programs",         0x0, test_reject,    cleanup, },
+	{ "surviving damaged programs",    0x0, test_damage,    cleanup, },
+	{ "refusing bad loop bounds",      0x0, test_bounds,    cleanup, },
+	{ "refusing ways out of a loop",   0x0, test_escape,    cleanup, },
+	{ 0x0 },
+};
+
+char const *src[] = {
+	"hello",
+	"^(GET|POST) (/[a-z.]*)",
+	"(a|ab)(c|bcd)(d*)",
+	"x[0-9]{2,4}y",
+	"(ab){300}$",
+	"((a)|(b))+c",
+};
+
+char const *txt[] = {
+	"oh hello there",
+	"GET /index.html HTTP/1.1",
+	"xxabcdddd",
+	"x123y x12345y",
+	"",
+	"aabbbac",
+};
+
+struct pattern pat[2];
+uint32_t out[1 << 12];
+
+void
+cleanup()
+{
+	pat_free(pat);
+	pat_free(pat + 1);
+	memset(pat, 0, sizeof pat);
+}
+
+void
+test_roundtrip()
+{
+	struct patplan plan[2];
+	size_t len;
+	size_t i;
+	size_t j;
+	int err;
+
+	for (i = 0; i < array_len(src); ++i) {
+		try(pat_compile(pat, src[i]));
+
+		expect(0, pat_dump(pat, 0x0, &len));
+		ok(len <= sizeof out);
+		expect(0, pat_dump(pat, out, &len));
+		expectf(0, pat_load(pat + 1, out, len), "'%s' loads", src[i]);
+
+		expect(true, pat[1].mapped);
+		expect(pat->nsub, pat[1].nsub);
+
+		pat_explain(pat, plan);
+		pat_explain(pat + 1, plan + 1);
+		expect(plan[0].find, plan[1].find);
+		expect(plan[0].sub, plan[1].sub);
+
+		for (j = 0; j < array_len(txt); ++j) {
+			err = pat_execute(pat, txt[j]);
+			expect(err, pat_execute(pat + 1, txt[j]));
+			if (err) continue;
+
+			expect(pat->nmat, pat[1].nmat);
+			expect(0, memcmp(pat->mat, pat[1].mat, pat->nmat * sizeof *pat->mat));
+		}
+
+		pat_free(pat);
+		pat_free(pat + 1);
+	}
+
+	memset(pat, 0, sizeof pat);
+}
+
+void
+test_mmap()
+{
+	FILE *f;
+	void *map;
+	size_t len = sizeof out;
+
+	try(pat_compile(pat, "(GET|POST) (/.*)\\.html"));
+	expect(0, pat_dump(pat, out, &len));
+
+	f = tmpfile();
+	ok(f != 0x0);
+	expect(1, fwrite(out, len, 1, f));
+	expect(0, fflush(f));
+
+	map = mmap(0x0, len, PROT_READ, MAP_PRIVATE, fileno(f), 0);
+	ok(map != MAP_FAILED);
+
+	expect(0, pat_load(pat + 1, map, len));
+	expect(0, pat_execute(pat + 1, "GET /index.html HTTP/1.1"));
+	expect(3, pat[1].nmat);
+	expect(4, pat[1].mat[2].off);
+	expect(6, pat[1].mat[2].ext);
+
+	pat_free(pat + 1);
+	memset(pat + 1, 0, sizeof *pat);
+
+	munmap(map, len);
+	fclose(f);
+}
+
+void
+test_reject()
+{
+	struct pathead *hd = (void *)out;
+	struct ins *prog = (void *)(hd + 1);
+	size_t len = sizeof out;
+	size_t small = 4;
+	size_t pc;
+
+	try(pat_compile(pat, "a(b)c"));
+
+	expect(ERANGE, pat_dump(pat, out, &small));
+	expect(0, pat_dump(pat, out, &len));
+	expect(len, small);
+
+	expect(EINVAL, pat_load(pat + 1, out, len - 1));
+	expect(EINVAL, pat_load(pat + 1, out, 4));
+	expect(EINVAL, pat_load(pat + 1, (char *)out + 1, len));
+
+	hd->version = DUMP_VERSION + 1;
+	expect(ENOTSUP, pat_load(pat + 1, out, len));
+	hd->version = DUMP_VERSION;
+
+	hd->magic[0] = 'x';
+	expect(EINVAL, pat_load(pat + 1, out, len));
+	hd->magic[0] = 'p';
+
+	hd->nsub = 7;
+	expect(EINVAL, pat_load(pat + 1, out, len));
+	hd->nsub = 1;
+
+	/* a group that is closed but never opened */
+	for (pc = PROG_ENTRY + 1; prog[pc].op != op_mark; ++pc) continue;
+	prog[pc].op = op_char;
+	expect(EINVAL, pat_load(pat + 1, out, len));
+	prog[pc].op = op_mark;
+
+	/* a jump back onto itself */
+	prog[PROG_ENTRY + 1] = (struct ins){ op_jump, 0 };
+	expect(EINVAL, pat_load(pat + 1, out, len));
+
+	expect(true, pat[1].prog == 0x0);
+}
+
+void
+test_damage()
+{
+	unsigned long r = 1;
+	size_t len = sizeof out;
+	size_t at;
+	size_t i;
+	size_t j;
+
+	try(pat_compile(pat, "(a|b)*c{2,3}(d)"));
+	expect(0, pat_dump(pat, out, &len));
+
+	/* whatever loads has to run without going astray */
+	for (i = 0; i < 4096; ++i) {
+		expect(0, pat_dump(pat, out, &len));
+
+		for (j = 0; j < 2; ++j) {
+			r = r * 1103515245 + 12345;
+			at = sizeof (struct pathead) + (r >> 8) % (len - sizeof (struct pathead));
+			((uint8_t *)out)[at] ^= 1 << (r >> 4) % 8;
+		}
+
+		if (pat_load(pat + 1, out, len)) continue;
+
+		pat_execute(pat + 1, "abbacccd");
+		pat_execute(pat + 1, "ccd");
+		pat_free(pat + 1);
+	}
+
+	memset(pat + 1, 0, sizeof *pat);
+}
+
+void
+test_bounds()
+{
+	struct pathead *hd = (void *)out;
+	struct ins *prog = (void *)(hd + 1);
+	struct {
+		int16_t min;
+		int16_t max;
+	} tab[] = {
+		{  5,  3 },
+		{ -1,  3 },
+		{  1, -1 },
+	};
+	char txt[5001];
+	size_t len = sizeof out;
+	size_t loop;
+	size_t i;
+
+	try(pat_compile(pat, "a{1,1000}"));
+	expect(0, pat_dump(pat, out, &len));
+	for (loop = PROG_ENTRY; prog[loop].op != op_loop; ++loop) continue;
+
+	/* a loop with fewer states than its bounds ask for would run off them */
+	for (i = 0; i < array_len(tab); ++i) {
+		expect(0, pat_dump(pat, out, &len));
+		prog[loop].arg = tab[i].min;
+		prog[loop + loop_len(prog + loop)].arg = tab[i].max;
+		expectf(EINVAL, pat_load(pat + 1, out, len), "a loop from %d to %d", tab[i].min, tab[i].max);
+	}
+
+	memset(txt, 'a', sizeof txt - 1);
+	txt[sizeof txt - 1] = 0;
+	expect(0, pat_dump(pat, out, &len));
+	expect(0, pat_load(pat + 1, out, len));
+	expect(0, pat_execute(pat + 1, txt));
+	expect(1000, pat[1].mat[0].ext);
+}
+
+void
+test_escape()
+{
+	struct pathead *hd = (void *)out;
+	struct ins *prog = (void *)(hd + 1);
+	/* a fork in the first loop lands in the body of the second */
+	struct ins bad[] = {
+		{ op_jump, 3 },
+		{ op_clss, 0 },
+		{ op_fork, -1 },
+		{ op_mark, 0 },
+		{ op_loop, 1 },
+		{ op_fork, 8 },
+		{ op_char, 'a' },
+		{ op_next, 2 },
+		{ op_jump, 7 },
+		{ op_char, 'q' },
+		{ op_char, 'q' },
+		{ op_char, 'q' },
+		{ op_loop, 1 },
+		{ op_char, 'z' },
+		{ op_next, 2 },
+		{ op_save, 0 },
+		{ op_halt, 0 },
+	};
+	size_t len = sizeof out;
+
+	try(pat_compile(pat, "a"));
+	expect(0, pat_dump(pat, out, &len));
+
+	hd->nsub = 0;
+	hd->len = array_len(bad);
+	memcpy(prog, bad, sizeof bad);
+	len = sizeof *hd + sizeof bad;
+
+	expect(EINVAL, pat_load(pat + 1, out, len));
+
+	/* the same with the fork kept inside its own loop loads */
+	prog[5].arg = 2;
+	expect(0, pat_load(pat + 1, out, len));
+	expect(0, pat_execute(pat + 1, "qqqaz"));
+}
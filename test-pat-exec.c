@@ -4,19 +4,26 @@
 char unit_filename[] = "pat-exec.c";
 
 void setup_plain(char *);
+void setup_sub(char *);
 void cleanup();
 void test_match();
+void test_nocap();
+void test_share();
+void test_count();
 
 struct test unit_tests[] = {
 	{ "doing nothing", setup_plain, test_match, cleanup, "abc" },
+	{ "skipping captures",  setup_plain, test_nocap, cleanup, "abc" },
+	{ "sharing captures",   setup_sub,   test_share, cleanup, "xabcd" },
+	{ "counting loops",     0x0,         test_count, cleanup, },
 	{ 0x0 }
 };
 
 struct ins plain[] = {
-	{ do_char, 'a' },
-	{ do_char, 'b' },
-	{ do_char, 'c' },
-	{ do_halt },
+	{ op_char, 'a' },
+	{ op_char, 'b' },
+	{ op_char, 'c' },
+	{ op_halt },
 };
 
 struct context ctx[1];
@@ -31,10 +38,22 @@ setup_plain(char *txt)
 	try(ctx_init(ctx, pat));
 }
 
+void
+setup_sub(char *txt)
+{
+	ctx->str = txt;
+	ctx->len = strlen(txt);
+	try(pat_compile(pat, "(a|ab)(c|bcd)"));
+	try(ctx_init(ctx, pat));
+}
+
 void
 cleanup()
 {
 	try(ctx_fini(ctx));
+	if (pat->prog != plain) pat_free(pat);
+	memset(ctx, 0, sizeof *ctx);
+	memset(pat, 0, sizeof *pat);
 }
 
 void
@@ -43,3 +62,46 @@ test_match()
 	expect(0, pat_exec(ctx));
 	expect(0, pat_fini(ctx));
 }
+
+void
+test_nocap()
+{
+	expect(0, pat_exec(ctx));
+	expect(0, pat_fini(ctx));
+
+	ok(ctx->res->cap == 0x0);
+	ok(ctx->cfl == 0x0);
+}
+
+void
+test_count()
+{
+	char txt[1002];
+
+	memset(txt, 'x', sizeof txt - 1);
+	txt[sizeof txt - 1] = 0;
+
+	try(pat_compile(pat, "(x){1,1000}"));
+	ok(prog_len(pat->prog) < 16);
+
+	expect(0, pat_execute(pat, txt));
+	expect(1000, pat->mat[0].ext);
+	expect(1001, pat->nmat);
+	expect(999, pat->mat[1000].off);
+}
+
+void
+test_share()
+{
+	expect(0, pat_exec(ctx));
+	expect(0, pat_fini(ctx));
+
+	ok(ctx->res->cap != 0x0);
+	expect(1, ctx->res->cap->ref);
+
+	expect(3, ctx->res->nmat);
+	expect(1, thr_match(ctx->res, 1)->off);
+	expect(1, thr_match(ctx->res, 1)->ext);
+	expect(2, thr_match(ctx->res, 2)->off);
+	expect(3, thr_match(ctx->res, 2)->ext);
+}
@@ -0,0 +1,132 @@
+#include <unit.h>
+#include <util.h>
+#include <pat-gen.c>
+
+char unit_filename[] = "pat-gen.c";
+
+static void cleanup();
+static void test_made();
+static void test_refuse();
+static void test_write();
+
+struct test unit_tests[] = {
+	{ "matching like pat_execute", 0x0, test_made,   cleanup, },
+	{ "writing a state machine",   0x0, test_write,  cleanup, },
+	{ "refusing what it cannot",   0x0, test_refuse, cleanup, },
+	{ 0x0 },
+};
+
+/* made by patgen from pat-gen.pat */
+int gen_alt(char const *, size_t, struct patmatch *);
+int gen_any(char const *, size_t, struct patmatch *);
+int gen_class(char const *, size_t, struct patmatch *);
+int gen_empty(char const *, size_t, struct patmatch *);
+int gen_hello(char const *, size_t, struct patmatch *);
+int gen_http(char const *, size_t, struct patmatch *);
+int gen_mail(char const *, size_t, struct patmatch *);
+
+struct pattern pat[1];
+char *out;
+size_t len;
+
+void
+cleanup()
+{
+	if (pat->prog) pat_free(pat);
+	memset(pat, 0, sizeof *pat);
+
+	free(out);
+	out = 0x0;
+}
+
+void
+test_made()
+{
+	struct {
+		char const *src;
+		int (*fn)(char const *, size_t, struct patmatch *);
+	} tab[] = {
+		{ "hello",                 gen_hello, },
+		{ "[a-z]+@[a-z]+\\.com",   gen_mail,  },
+		{ "^(GET|POST) (/[a-z.]*)", gen_http, },
+		{ "(a|ab)(c|bcd)(d*)",     gen_alt,   },
+		{ "x[0-9]{2,4}y",          gen_class, },
+		{ "a.*b",                  gen_any,   },
+		{ "x*",                    gen_empty, },
+	};
+	char const *txt[] = {
+		"",
+		"oh hello there, hell",
+		"mail me@example.com or you@x.co",
+		"GET /index.html HTTP/1.1",
+		"POST/",
+		"xxabcdddd abcd",
+		"x1y x123y x12345y",
+		"ba a\nb",
+		"xxx",
+	};
+	struct patmatch mat;
+	size_t i;
+	size_t j;
+	int err;
+
+	for (i = 0; i < array_len(tab); ++i) {
+		try(pat_compile(pat, tab[i].src));
+
+		for (j = 0; j < array_len(txt); ++j) {
+			err = pat_execute(pat, txt[j]);
+			expectf(err, tab[i].fn(txt[j], strlen(txt[j]), &mat), "'%s' on '%s'", tab[i].src, txt[j]);
+			if (err) continue;
+
+			expect(pat->mat[0].off, mat.off);
+			expect(pat->mat[0].ext, mat.ext);
+		}
+
+		pat_free(pat);
+		memset(pat, 0, sizeof *pat);
+	}
+}
+
+void
+test_write()
+{
+	FILE *f;
+
+	f = open_memstream(&out, &len);
+	ok(f != 0x0);
+
+	expect(0, gen_match(f, "find", "ab+c|d*/"));
+	expect(0, fclose(f));
+
+	ok(strstr(out, "int\nfind(char const *buf, size_t len, struct patmatch *mat)") != 0x0);
+	ok(strstr(out, "goto f0;") != 0x0);
+	ok(strstr(out, "goto r0;") != 0x0);
+
+	/* the pattern heads the function, but cannot end its comment */
+	ok(strstr(out, "/* ab+c|d*\\/ */") != 0x0);
+	free(out);
+
+	f = open_memstream(&out, &len);
+	ok(f != 0x0);
+
+	/* an anchored pattern needs no way back to where it began */
+	expect(0, gen_match(f, "find", "^abc"));
+	expect(0, fclose(f));
+	ok(strstr(out, "goto r0;") == 0x0);
+}
+
+void
+test_refuse()
+{
+	FILE *f;
+
+	f = open_memstream(&out, &len);
+	ok(f != 0x0);
+
+	expect(ENOTSUP, gen_match(f, "find", "ab$"));
+	expect(ENOTSUP, gen_match(f, "find", "a{300}"));
+	expect(ENOTSUP, gen_match(f, "find", "[ab]*a[ab]{9}"));
+	expect(PAT_ERR_BADPAREN, gen_match(f, "find", "(ab"));
+
+	expect(0, fclose(f));
+}
@@ -0,0 +1,159 @@
+/* first, for the MAP_ANONYMOUS it asks for to be seen by every header */
+#include <pat-jit.c>
+#include <unit.h>
+#include <util.h>
+
+char unit_filename[] = "pat-jit.c";
+
+static void cleanup();
+static void setup_table();
+static void test_big();
+static void test_hot();
+static void test_resume();
+static void test_table();
+
+struct test unit_tests[] = {
+	{ "running a table of states",    setup_table, test_table,  cleanup, },
+	{ "going on from the caller",     setup_table, test_resume, cleanup, },
+	{ "compiling only when asked",    0x0,         test_hot,    cleanup, },
+	{ "leaving big patterns be",      0x0,         test_big,    cleanup, },
+	{ 0x0 },
+};
+
+struct jit *jit;
+struct pattern pat[1];
+
+/* looks for "ab": 0 has nothing, 1 has the a, 2 has all of it */
+uint16_t next[3 * 256];
+uint8_t flags[3] = { 0, 0, DT_ACCEPT | DT_EXIT };
+
+void
+setup_table()
+{
+	size_t i;
+
+	for (i = 0; i < 256; ++i) {
+		next[0 * 256 + i] = i == 'a';
+		next[1 * 256 + i] = i == 'a' ? 1 : i == 'b' ? 2 : 0;
+		next[2 * 256 + i] = 2;
+	}
+
+	try(jit_alloc(&jit, next, flags, 3));
+}
+
+void
+cleanup()
+{
+	jit_free(jit);
+	jit = 0x0;
+
+	if (pat->prog) pat_free(pat);
+	memset(pat, 0, sizeof *pat);
+}
+
+void
+test_table()
+{
+	uint8_t const *txt = (void const *)"xaxaab..";
+	size_t st = 0;
+	size_t end = -1;
+
+	/* with nothing to compile to, the interpreters are all there is */
+	if (!jit) return;
+
+	expect(6, jit_run(jit, txt, 0, 8, &st, &end));
+	expect(2, st);
+	expect(6, end);
+
+	st = 0;
+	end = -1;
+	expect(4, jit_run(jit, txt, 0, 4, &st, &end));
+	expect(1, st);
+	expect(true, end == -1UL);
+
+	/* a state the caller has to see to is given straight back */
+	st = 2;
+	expect(7, jit_run(jit, txt, 7, 8, &st, &end));
+	expect(2, st);
+}
+
+void
+test_resume()
+{
+	uint8_t const *txt = (void const *)"bab";
+	size_t st = 1;
+	size_t end = 0;
+
+	if (!jit) return;
+
+	expect(1, jit_run(jit, txt, 0, 3, &st, &end));
+	expect(2, st);
+	expect(1, end);
+
+	st = 0;
+	expect(3, jit_run(jit, txt, 0, 3, &st, &end));
+	expect(2, st);
+	expect(3, end);
+}
+
+void
+test_hot()
+{
+	struct {
+		char const *src;
+		char const *txt;
+		size_t      off;
+		size_t      ext;
+	} tab[] = {
+		{ "[a-z]+@[a-z]+\\.com", "mail me@example.com!",   5, 14 },
+		{ "(GET|POST) (/.*)\\.html", "x POST /a/b.html y", 2, 14 },
+		{ "[a-z]{70}",           "0abcdefghijklmnopqrstuvwxyzabcdefghijklmnopqrstuvwxyzabcdefghijklmnopqrstuvwxyz", 1, 70 },
+	};
+	int flags[] = { 0, PAT_JIT };
+	struct patplan plan;
+	size_t i;
+	size_t j;
+	size_t k;
+
+	for (k = 0; k < array_len(flags); ++k) for (i = 0; i < array_len(tab); ++i) {
+		try(pat_compile_flags(pat, tab[i].src, flags[k]));
+
+		/* the same matches before and after */
+		for (j = 0; j < JIT_AFTER * 2; ++j) {
+			expect(PAT_ERR_NOMATCH, pat_execute(pat, "nothing to see here"));
+			expect(0, pat_execute(pat, tab[i].txt));
+			expect(tab[i].off, pat->mat[0].off);
+			expect(tab[i].ext, pat->mat[0].ext);
+		}
+
+		/* unless asked to, it stays with the interpreters however hot */
+		expect(0, pat_explain(pat, &plan));
+#if defined(__x86_64__)
+		expectf(flags[k] == PAT_JIT, plan.jit, "'%s' is compiled with flags %d", tab[i].src, flags[k]);
+#else
+		expect(false, plan.jit);
+#endif
+
+		pat_free(pat);
+		memset(pat, 0, sizeof *pat);
+	}
+}
+
+void
+test_big()
+{
+	struct patplan plan;
+	size_t j;
+
+	/* a dfa for this needs a state for each way the last nine bytes went */
+	try(pat_compile_flags(pat, "[ab]*a[ab]{8}", PAT_JIT));
+
+	for (j = 0; j < JIT_AFTER * 2; ++j) {
+		expect(0, pat_execute(pat, "bbbabbbbbbbbb"));
+		expect(0, pat->mat[0].off);
+		expect(12, pat->mat[0].ext);
+	}
+
+	expect(0, pat_explain(pat, &plan));
+	expect(false, plan.jit);
+}
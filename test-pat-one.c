@@ -0,0 +1,44 @@
+#include <unit.h>
+#include <util.h>
+#include <pat-one.c>
+
+char unit_filename[] = "pat-one.c";
+
+static void cleanup();
+static void test_detect();
+
+struct test unit_tests[] = {
+	{ "telling one-pass programs apart", 0x0, test_detect, cleanup, },
+	{ 0x0 },
+};
+
+struct pattern pat[1];
+
+void
+cleanup()
+{
+	try(pat_free(pat));
+	memset(pat, 0, sizeof *pat);
+}
+
+void
+test_detect()
+{
+	char const *yes[] = { "(a+)=([0-9]+)", "x(ab|cd)*y", "(a)(b)?", "^(a+)b" };
+	char const *no[] = { "(a*)(a*)", "(a|ab)(c|bcd)", "(a*)*b", "(a)|(a)", "(.*)x" };
+	size_t i;
+
+	for (i = 0; i < array_len(yes); ++i) {
+		try(pat_compile(pat, yes[i]));
+		expectf(true, pat->one != 0x0, "'%s' is one-pass", yes[i]);
+		try(pat_free(pat));
+	}
+
+	for (i = 0; i < array_len(no); ++i) {
+		try(pat_compile(pat, no[i]));
+		expectf(true, pat->one == 0x0, "'%s' is not one-pass", no[i]);
+		try(pat_free(pat));
+	}
+
+	memset(pat, 0, sizeof *pat);
+}
@@ -0,0 +1,140 @@
+#include <unit.h>
+#include <util.h>
+#include <pat-plan.c>
+
+char unit_filename[] = "pat-plan.c";
+
+static void cleanup();
+static void test_bounds();
+static void test_engines();
+static void test_literals();
+static void test_short();
+
+struct test unit_tests[] = {
+	{ "finding match lengths",   0x0, test_bounds,   cleanup, },
+	{ "finding literals",        0x0, test_literals, cleanup, },
+	{ "picking engines",         0x0, test_engines,  cleanup, },
+	{ "turning short text away", 0x0, test_short,    cleanup, },
+	{ 0x0 },
+};
+
+struct pattern pat[1];
+
+void
+cleanup()
+{
+	memset(pat, 0, sizeof *pat);
+}
+
+void
+test_bounds()
+{
+	struct {
+		char const *src;
+		size_t      min;
+		size_t      max;
+	} tab[] = {
+		{ "abc",       3,  3 },
+		{ "ab?c",      2,  3 },
+		{ "(a|bcd)e",  2,  4 },
+		{ "a{2,5}",    2,  5 },
+		{ "^abc$",     3,  3 },
+		{ "x*",        0, -1 },
+		{ "(ab)+",     2, -1 },
+		{ "a{300}",    1, -1 },
+	};
+	struct patplan plan;
+	size_t i;
+
+	for (i = 0; i < array_len(tab); ++i) {
+		try(pat_compile(pat, tab[i].src));
+		expect(0, pat_explain(pat, &plan));
+		expectf(tab[i].min, plan.min, "'%s' is at least %zu long", tab[i].src, tab[i].min);
+		expectf(tab[i].max, plan.max, "'%s' is at most %zu long", tab[i].src, tab[i].max);
+		pat_free(pat);
+	}
+}
+
+void
+test_literals()
+{
+	struct patplan plan;
+
+	try(pat_compile(pat, "hello.*world"));
+	expect(0, pat_explain(pat, &plan));
+	expect(5, plan.npre);
+	expect(0, memcmp(plan.pre, "hello", 5));
+	expect(5, plan.nsuf);
+	expect(0, memcmp(plan.suf, "world", 5));
+	expect(false, plan.anchored);
+	pat_free(pat);
+
+	try(pat_compile(pat, "(GET|POST) (/.*)\\.html"));
+	expect(0, pat_explain(pat, &plan));
+	expect(0, plan.npre);
+	expect(5, plan.nsuf);
+	expect(0, memcmp(plan.suf, ".html", 5));
+	expect(2, plan.nsub);
+	pat_free(pat);
+
+	try(pat_compile(pat, "^ab|b"));
+	expect(0, pat_explain(pat, &plan));
+	expect(0, plan.npre);
+	expect(0, plan.nsuf);
+	pat_free(pat);
+
+	try(pat_compile(pat, "^abc"));
+	expect(0, pat_explain(pat, &plan));
+	expect(true, plan.anchored);
+	expect(3, plan.npre);
+	expect(3, plan.nsuf);
+	pat_free(pat);
+}
+
+void
+test_engines()
+{
+	struct {
+		char const    *src;
+		enum patengine find;
+		enum patengine sub;
+	} tab[] = {
+		{ "hello",        PAT_SHIFT, PAT_NONE,      },
+		{ "[a-z]{70}",    PAT_DFA,   PAT_NONE,      },
+		{ "(a+)=(b+)",    PAT_SHIFT, PAT_ONEPASS,   },
+		{ "(.*)x",        PAT_SHIFT, PAT_BACKTRACK, },
+		{ "a{300}",       PAT_VM,    PAT_NONE,      },
+		{ "(a)$",         PAT_VM,    PAT_VM,        },
+	};
+	struct patplan plan;
+	size_t i;
+
+	for (i = 0; i < array_len(tab); ++i) {
+		try(pat_compile(pat, tab[i].src));
+		expect(0, pat_explain(pat, &plan));
+		expectf(tab[i].find, plan.find, "'%s' is found by %s", tab[i].src, pat_engine(tab[i].find));
+		expectf(tab[i].sub, plan.sub, "'%s' has its submatches from %s", tab[i].src, pat_engine(tab[i].sub));
+		expect(tab[i].sub == PAT_ONEPASS, plan.onepass);
+		if (tab[i].sub == PAT_BACKTRACK) ok(plan.back > 0);
+		pat_free(pat);
+	}
+
+	expect(EFAULT, pat_explain(0x0, &plan));
+	expect(EFAULT, pat_explain(pat, 0x0));
+}
+
+void
+test_short()
+{
+	try(pat_compile(pat, "abc+d"));
+	expect(PAT_ERR_NOMATCH, pat_execute(pat, "abd"));
+	expect(0, pat_execute(pat, "xxabcd"));
+	expect(2, pat->mat[0].off);
+	pat_free(pat);
+
+	try(pat_compile(pat, "(a|bb)c{0,1}$"));
+	expect(PAT_ERR_NOMATCH, pat_execute(pat, ""));
+	expect(0, pat_execute(pat, "xbb"));
+	expect(1, pat->mat[0].off);
+	pat_free(pat);
+}
@@ -0,0 +1,77 @@
+#include <unit.h>
+#include <pat-shift.c>
+
+char unit_filename[] = "pat-shift.c";
+
+static void setup(char *);
+static void cleanup();
+static void test_empty();
+static void test_end();
+static void test_long();
+
+struct test unit_tests[] = {
+	{ "matching the empty string",     setup, test_empty, cleanup, "d*", },
+	{ "stopping at the end of a buffer", setup, test_end, cleanup, "b", },
+	{ "falling back past 64 positions", 0x0,  test_long,  cleanup, },
+	{ 0x0 },
+};
+
+struct pattern pat[1];
+
+void
+setup(char *src)
+{
+	try(pat_compile(pat, src));
+
+	/* use the shift-and engine whatever pat_compile picked */
+	if (!pat->sft) try(shift_alloc(&pat->sft, pat->prog, prog_len(pat->prog), 0x0));
+	ok(pat->sft != 0x0);
+}
+
+void
+cleanup()
+{
+	try(pat_free(pat));
+	memset(pat, 0, sizeof *pat);
+}
+
+void
+test_empty()
+{
+	expect(0, shift_match(pat, pat->sft, "abc", 3, -1));
+	expect(0, pat->mat[0].off);
+	expect(0, pat->mat[0].ext);
+
+	expect(0, shift_match(pat, pat->sft, "ddd", 3, -1));
+	expect(3, pat->mat[0].ext);
+
+	expect(0, shift_match(pat, pat->sft, "", 0, -1));
+}
+
+void
+test_end()
+{
+	/* the prefix is nowhere in the buffer, only just past it */
+	expect(-1, shift_match(pat, pat->sft, "xxxb", 3, -1));
+	expect(-1, shift_match(pat, pat->sft, "xxxb", 3, 2));
+	expect(0, shift_match(pat, pat->sft, "xxxb", 4, -1));
+}
+
+void
+test_long()
+{
+	char src[66];
+
+	memset(src, 'a', 65);
+	src[65] = 0;
+
+	try(pat_compile(pat, src));
+	ok(pat->sft == 0x0);
+	ok(pat->dfa != 0x0);
+
+	src[64] = 0;
+	try(pat_free(pat));
+	try(pat_compile(pat, src));
+	ok(pat->sft != 0x0);
+	expect(0, pat_execute(pat, src));
+}
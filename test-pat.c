@@ -1,10 +1,13 @@
+#include <errno.h>
 #include <unit.h>
 #include <pat.h>
+#include <pat.ih>
 #include <util.h>
 #include <vec.h>
 
 #define subm(...) ((struct patmatch[]){__VA_ARGS__, {-1, -1}})
 
+static int  execute(char const *);
 static void test_free(void);
 static void test_alter(void);
 static void test_esc(void);
@@ -14,7 +17,26 @@ static void test_sub(void);
 static void test_plain(void);
 static void test_plus(void);
 static void test_dot(void);
+static void test_bracket(void);
+static void test_badcls(void);
+static void test_count(void);
+static void test_badrep(void);
+static void test_anchor(void);
+static void test_anchored(void);
+static void test_nest(void);
+static void test_prefix(void);
 static void test_match(void);
+static void test_reuse(void);
+static void test_buffer(void);
+static void test_span(void);
+static void test_chunks(void);
+static void test_stream(void);
+static void test_set(void);
+static void test_iter(void);
+static void test_scan(void);
+static void test_engine(void);
+static void test_high(void);
+static void test_agree(void);
 
 struct a {
 	char *pat;
@@ -27,6 +49,8 @@ struct b {
 	struct patmatch *sub;
 };
 
+static void fill(char *, size_t, struct a *);
+
 char unit_filename[] = "pat.c";
 struct test unit_tests[] = {
 	{ "matching plaintext",  test_plain, test_match, test_free, },
@@ -37,6 +61,32 @@ struct test unit_tests[] = {
 	{ "matching |",      test_alter, test_match, test_free, },
 	{ "matching submatches",   test_sub,   test_match, test_free, },
 	{ "matching .", test_dot,   test_match, test_free, },
+	{ "matching brackets", test_bracket, test_match, test_free, },
+	{ "rejecting bad brackets", 0x0, test_badcls, test_free, },
+	{ "matching {m,n}", test_count, test_match, test_free, },
+	{ "rejecting bad bounds", 0x0, test_badrep, test_free, },
+	{ "matching ^ and $", test_anchor, test_match, test_free, },
+	{ "compiling anchored patterns", 0x0, test_anchored, test_free, },
+	{ "matching nested repetition", test_nest, test_match, test_free, },
+	{ "matching past false starts", test_prefix, test_match, test_free, },
+	{ "reusing a matcher", test_reuse, test_match, test_free, },
+	{ "matching length-delimited buffers", 0x0, test_buffer, test_free, },
+	{ "finding the span before submatches", 0x0, test_span, test_free, },
+	{ "matching across chunks", test_chunks, test_stream, test_free, },
+	{ "matching prefixes across chunks", test_prefix, test_stream, test_free, },
+	{ "matching repetition across chunks", test_nest, test_stream, test_free, },
+	{ "matching {m,n} across chunks", test_count, test_stream, test_free, },
+	{ "matching ^ and $ across chunks", test_anchor, test_stream, test_free, },
+	{ "matching a pattern set", 0x0, test_set, 0x0, },
+	{ "iterating over matches", 0x0, test_iter, test_free, },
+	{ "scanning on threads", 0x0, test_scan, test_free, },
+	{ "matching bytes past ascii", test_high, test_match, test_free, },
+	{ "matching what each engine takes", test_engine, test_match, test_free, },
+	{ "agreeing with the vm", test_engine, test_agree, test_free, },
+	{ "agreeing past ascii", test_high, test_agree, test_free, },
+	{ "agreeing on submatches", test_sub, test_agree, test_free, },
+	{ "agreeing on nested repetition", test_nest, test_agree, test_free, },
+	{ "agreeing on brackets", test_bracket, test_agree, test_free, },
 	{ 0x0 },
 };
 
@@ -192,6 +242,13 @@ struct a sub[] = {
 		{ 0x0 } },
 	},
 
+	{ "(a)(b)(c)(d)(e)(f)(g)(h)(i)(j)(k)(l)", (struct b[]) {
+		{ "abcdefghijkl", subm({0, 12}, {0, 1}, {1, 1}, {2, 1}, {3, 1}, {4, 1},
+		                       {5, 1}, {6, 1}, {7, 1}, {8, 1}, {9, 1}, {10, 1},
+		                       {11, 1}) },
+		{ 0x0 } },
+	},
+
 	{ "abc(def|ghi)jkl", (struct b[]) {
 		{ "abcdefjkl", subm({0, 9}, {3,3})},
 		{ "abcghijkl", subm({0, 9}, {3,3})},
@@ -245,9 +302,384 @@ struct a dot[] = {
 	{ 0x0 },
 };
 
+struct a nest[] = {
+	{ "(ab)*c", (struct b[]) {
+		{ "ababc", subm({0, 5}, {0, 2}, {2, 2}) },
+		{ "c",     subm({0, 1}) },
+		{ 0x0 } },
+	},
+
+	{ "(a|b)*c", (struct b[]) {
+		{ "xabc", subm({1, 3}, {1, 1}, {2, 1}) },
+		{ 0x0 } },
+	},
+
+	{ "(a*)*b", (struct b[]) {
+		{ "aaab", subm({0, 4}, {0, 3}) },
+		{ "b",    subm({0, 1}) },
+		{ 0x0 } },
+	},
+
+	{ "(a|a)*b", (struct b[]) {
+		{ "aab", subm({0, 3}, {0, 1}, {1, 1}) },
+		{ 0x0 } },
+	},
+
+	{ "(a|a)*(a|a)*c", (struct b[]) {
+		{ "aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaac",
+		  subm({0, 64}, {0, 1}, {1, 1}, {2, 1}, {3, 1}, {4, 1},
+		       {5, 1}, {6, 1}, {7, 1}, {8, 1}, {9, 1}, {10, 1}, {11, 1},
+		       {12, 1}, {13, 1}, {14, 1}, {15, 1}, {16, 1}, {17, 1}, {18, 1},
+		       {19, 1}, {20, 1}, {21, 1}, {22, 1}, {23, 1}, {24, 1}, {25, 1},
+		       {26, 1}, {27, 1}, {28, 1}, {29, 1}, {30, 1}, {31, 1}, {32, 1},
+		       {33, 1}, {34, 1}, {35, 1}, {36, 1}, {37, 1}, {38, 1}, {39, 1},
+		       {40, 1}, {41, 1}, {42, 1}, {43, 1}, {44, 1}, {45, 1}, {46, 1},
+		       {47, 1}, {48, 1}, {49, 1}, {50, 1}, {51, 1}, {52, 1}, {53, 1},
+		       {54, 1}, {55, 1}, {56, 1}, {57, 1}, {58, 1}, {59, 1}, {60, 1},
+		       {61, 1}, {62, 1}) },
+		{ 0x0 } },
+
+		(struct b[]) {
+		{ "aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa" },
+		{ 0x0 } },
+	},
+
+	{ 0x0 },
+};
+
+struct a bracket[] = {
+	{ "[a-z0-9_]+", (struct b[]) {
+		{ "--ab_9Z", subm({2, 4}) },
+		{ 0x0 } },
+
+		(struct b[]) {
+		{ "--ABC--" },
+		{ 0x0 } },
+	},
+
+	{ "[^a-c]+", (struct b[]) {
+		{ "abcxyz", subm({3, 3}) },
+		{ "ab\nc",  subm({2, 1}) },
+		{ 0x0 } },
+
+		(struct b[]) {
+		{ "cabbac" },
+		{ 0x0 } },
+	},
+
+	{ "[]a-]+", (struct b[]) {
+		{ "x]-a]", subm({1, 4}) },
+		{ 0x0 } },
+	},
+
+	{ "[\\]^.]", (struct b[]) {
+		{ "ab.c", subm({2, 1}) },
+		{ "a^",   subm({1, 1}) },
+		{ "]",    subm({0, 1}) },
+		{ 0x0 } },
+
+		(struct b[]) {
+		{ "abc" },
+		{ 0x0 } },
+	},
+
+	{ "([0-9]+)-([0-9]+)", (struct b[]) {
+		{ "tel 555-1234", subm({4, 8}, {4, 3}, {8, 4}) },
+		{ 0x0 } },
+	},
+
+	{ "x[ab]*y|[c]", (struct b[]) {
+		{ "xababy", subm({0, 6}) },
+		{ "ddc",    subm({2, 1}) },
+		{ 0x0 } },
+	},
+
+	{ 0x0 },
+};
+
+struct a count[] = {
+	{ "ab{2}c", (struct b[]) {
+		{ "abbbc abbc", subm({6, 4}) },
+		{ 0x0 } },
+
+		(struct b[]) {
+		{ "abc" },
+		{ "abbbc" },
+		{ 0x0 } },
+	},
+
+	{ "xa{2,}", (struct b[]) {
+		{ "xaxaaaa", subm({2, 5}) },
+		{ 0x0 } },
+
+		(struct b[]) {
+		{ "xaxa" },
+		{ 0x0 } },
+	},
+
+	{ "a{0,2}b", (struct b[]) {
+		{ "b",     subm({0, 1}) },
+		{ "aaaab", subm({2, 3}) },
+		{ 0x0 } },
+	},
+
+	{ "(ab|c){1,3}d", (struct b[]) {
+		{ "ababcabd", subm({2, 6}, {2, 2}, {4, 1}, {5, 2}) },
+		{ 0x0 } },
+	},
+
+	{ "(a[bc]){2,300}d", (struct b[]) {
+		{ "xabacabd", subm({1, 7}, {1, 2}, {3, 2}, {5, 2}) },
+		{ 0x0 } },
+
+		(struct b[]) {
+		{ "abd" },
+		{ 0x0 } },
+	},
+
+	{ "x{0,1000}y", (struct b[]) {
+		{ "y",      subm({0, 1}) },
+		{ "axxxy",  subm({1, 4}) },
+		{ 0x0 } },
+	},
+
+	{ "a{3,260}", (struct b[]) {
+		{ "aabaaaa", subm({3, 4}) },
+		{ 0x0 } },
+
+		(struct b[]) {
+		{ "aabaa" },
+		{ 0x0 } },
+	},
+
+	{ "a{0}b|{x}", (struct b[]) {
+		{ "ab",  subm({1, 1}) },
+		{ "{x}", subm({0, 3}) },
+		{ 0x0 } },
+	},
+
+	{ "a{,2}", (struct b[]) {
+		{ "a{,2}", subm({0, 5}) },
+		{ 0x0 } },
+	},
+
+	{ 0x0 },
+};
+
+struct a anchor[] = {
+	{ "^ab*", (struct b[]) {
+		{ "abbba", subm({0, 4}) },
+		{ 0x0 } },
+
+		(struct b[]) {
+		{ "babb" },
+		{ "" },
+		{ 0x0 } },
+	},
+
+	{ "b+$", (struct b[]) {
+		{ "abbabb", subm({4, 2}) },
+		{ 0x0 } },
+
+		(struct b[]) {
+		{ "bba" },
+		{ 0x0 } },
+	},
+
+	{ "^(a|b)+$", (struct b[]) {
+		{ "abba", subm({0, 4}, {0, 1}, {1, 1}, {2, 1}, {3, 1}) },
+		{ 0x0 } },
+
+		(struct b[]) {
+		{ "abca" },
+		{ 0x0 } },
+	},
+
+	{ "^x|y$", (struct b[]) {
+		{ "xay",  subm({0, 1}) },
+		{ "axay", subm({3, 1}) },
+		{ 0x0 } },
+
+		(struct b[]) {
+		{ "axya" },
+		{ 0x0 } },
+	},
+
+	{ "^$", (struct b[]) {
+		{ "", subm({0, 0}) },
+		{ 0x0 } },
+
+		(struct b[]) {
+		{ "a" },
+		{ 0x0 } },
+	},
+
+	{ "a*$", (struct b[]) {
+		{ "aab", subm({3, 0}) },
+		{ 0x0 } },
+	},
+
+	{ "a^b|\\^", (struct b[]) {
+		{ "ab^", subm({2, 1}) },
+		{ 0x0 } },
+	},
+
+	{ 0x0 },
+};
+
+struct a prefix[] = {
+	{ "abc", (struct b[]) {
+		{ "ababxabcab", subm({5, 3}) },
+		{ "aaabc",      subm({2, 3}) },
+		{ 0x0 } },
+
+		(struct b[]) {
+		{ "ab ab ab" },
+		{ "ab" },
+		{ 0x0 } },
+	},
+
+	{ "a(b|c)d", (struct b[]) {
+		{ "abacad acd", subm({7, 3}, {8, 1}) },
+		{ 0x0 } },
+	},
+
+	{ "(x|y)z", (struct b[]) {
+		{ "xxyyz", subm({3, 2}, {3, 1}) },
+		{ 0x0 } },
+
+		(struct b[]) {
+		{ "xyxyx" },
+		{ 0x0 } },
+	},
+
+	{ "b|bc", (struct b[]) {
+		{ "aaabc", subm({3, 2}) },
+		{ 0x0 } },
+	},
+
+	{ 0x0 },
+};
+
+/* a pattern or two for each engine, checked against the vm by test_agree */
+struct a engine[] = {
+	{ "ab*c|b.d", (struct b[]) {
+		{ "xabbbc", subm({1, 5}) },
+		{ "cbad",   subm({1, 3}) },
+		{ 0x0 } },
+
+		(struct b[]) {
+		{ "abd" },
+		{ 0x0 } },
+	},
+
+	{ "a(b|cd)*d+|c", (struct b[]) {
+		{ "acdbd", subm({0, 5}, {1, 2}, {3, 1}) },
+		{ "bbc",   subm({2, 1}) },
+		{ 0x0 } },
+	},
+
+	{ "(a|b)*cccc|bad", (struct b[]) {
+		{ "abacccc", subm({0, 7}, {0, 1}, {1, 1}, {2, 1}) },
+		{ "xbad",    subm({1, 3}) },
+		{ 0x0 } },
+	},
+
+	{ "(a|ab)(c|bcd)(d*)", (struct b[]) {
+		{ "abcdd", subm({0, 5}, {0, 2}, {2, 1}, {3, 2}) },
+		{ 0x0 } },
+	},
+
+	{ "(.*)d", (struct b[]) {
+		{ "abdcd", subm({0, 5}, {0, 4}) },
+		{ 0x0 } },
+	},
+
+	{ "((a)|(b))+c", (struct b[]) {
+		{ "abc", subm({0, 3}, {0, 1}, {0, 1}, {1, 1}, {1, 1}) },
+		{ 0x0 } },
+	},
+
+	{ "(a+)(b|c)d?", (struct b[]) {
+		{ "aacd", subm({0, 4}, {0, 2}, {2, 1}) },
+		{ 0x0 } },
+	},
+
+	{ "d(a|b)*", (struct b[]) {
+		{ "cdabx", subm({1, 3}, {2, 1}, {3, 1}) },
+		{ 0x0 } },
+	},
+
+	{ 0x0 },
+};
+
+struct a high[] = {
+	{ "\xe9t\xe9", (struct b[]) {
+		{ "l'\xe9t\xe9", subm({2, 3}) },
+		{ 0x0 } },
+
+		(struct b[]) {
+		{ "ete" },
+		{ "\xe9t\xe8" },
+		{ 0x0 } },
+	},
+
+	{ "[\xe0-\xef]+", (struct b[]) {
+		{ "ab\xe1\xe9\xefz", subm({2, 3}) },
+		{ 0x0 } },
+
+		(struct b[]) {
+		{ "abc" },
+		{ "\xdf\xf0" },
+		{ 0x0 } },
+	},
+
+	{ "[^a-z]+", (struct b[]) {
+		{ "abc\xff\x80" "d", subm({3, 2}) },
+		{ 0x0 } },
+	},
+
+	{ "(\xe9|\xe9" "b)(c|bcd)", (struct b[]) {
+		{ "x\xe9" "bc", subm({1, 3}, {1, 2}, {3, 1}) },
+		{ 0x0 } },
+	},
+
+	{ "(\xc3[\xa0-\xbf])+x", (struct b[]) {
+		{ "\xc3\xa9\xc3\xa0x", subm({0, 5}, {0, 2}, {2, 2}) },
+		{ 0x0 } },
+
+		(struct b[]) {
+		{ "\xc3\xc0x" },
+		{ 0x0 } },
+	},
+
+	{ ".\xff", (struct b[]) {
+		{ "a\xff", subm({0, 2}) },
+		{ 0x0 } },
+	},
+
+	{ "(\xe9+)(\xe8|\xe9)\xea?", (struct b[]) {
+		{ "a\xe9\xe9\xe8\xea", subm({1, 4}, {1, 2}, {3, 1}) },
+		{ 0x0 } },
+	},
+
+	{ "\xe9(\xe0|\xe1)*", (struct b[]) {
+		{ "\xe9\xe1\xe0\xe2", subm({0, 3}, {1, 1}, {2, 1}) },
+		{ 0x0 } },
+	},
+
+	{ "(.*)\x80", (struct b[]) {
+		{ "a\x80\xff\x80!", subm({0, 4}, {0, 3}) },
+		{ 0x0 } },
+	},
+
+	{ 0x0 },
+};
+
 struct a *cur;
 
 struct pattern pat[1];
+struct patmatcher *pm;
 
 void test_alter(void) { cur = alter; }
 void test_qmark(void) { cur = qmark; }
@@ -257,12 +689,324 @@ void test_plain(void) { cur = plain; }
 void test_plus(void)  { cur = plus; }
 void test_esc(void)   { cur = esc; }
 void test_dot(void)   { cur = dot; }
+void test_bracket(void) { cur = bracket; }
+void test_count(void) { cur = count; }
+void test_anchor(void) { cur = anchor; }
+void test_nest(void)  { cur = nest; }
+void test_prefix(void) { cur = prefix; }
+void test_chunks(void) { cur = sub; }
+void test_engine(void) { cur = engine; }
+void test_high(void)  { cur = high; }
+
+void
+test_reuse(void)
+{
+	cur = sub;
+	pm = pat_matcher_alloc();
+	ok(pm != 0x0);
+}
+
+void
+test_badcls(void)
+{
+	expect(PAT_ERR_BADCLASS, pat_compile(pat, "[abc"));
+	expect(PAT_ERR_BADCLASS, pat_compile(pat, "[]"));
+	expect(PAT_ERR_BADCLASS, pat_compile(pat, "[z-a]"));
+	expect(PAT_ERR_BADCLASS, pat_compile(pat, "a[\\]"));
+}
+
+void
+test_badrep(void)
+{
+	expect(PAT_ERR_BADREP, pat_compile(pat, "a{3,2}"));
+	expect(PAT_ERR_BADREP, pat_compile(pat, "a{99999}"));
+	expect(PAT_ERR_BADREP, pat_compile(pat, "(a{1000}){1000}"));
+}
+
+void
+test_anchored(void)
+{
+	try(pat_compile_flags(pat, "b+", PAT_ANCHORED));
+	expect(0, pat_execute(pat, "bbab"));
+	expect(0, pat->mat[0].off);
+	expect(2, pat->mat[0].ext);
+	expect(-1, pat_execute(pat, "abb"));
+	try(pat_free(pat));
+
+	try(pat_compile_flags(pat, "(a|b)c", PAT_ANCHORED));
+	expect(0, pat_execute(pat, "bcac"));
+	expect(2, pat->mat[0].ext);
+	expect(-1, pat_execute(pat, "cac"));
+	try(pat_free(pat));
+
+	try(pat_compile_flags(pat, "x*", PAT_ANCHORED));
+	expect(0, pat_execute(pat, "axx"));
+	expect(0, pat->mat[0].ext);
+}
+
+int
+execute(char const *txt)
+{
+	if (pm) return pat_execute_with(pat, pm, txt);
+	return pat_execute(pat, txt);
+}
+
+void
+test_buffer(void)
+{
+	char const buf[] = "ab\0abc\0a\0c\na\nc";
+
+	try(pat_compile(pat, "abc"));
+	expect(0, pat_execute_n(pat, buf, sizeof buf - 1));
+	expect(3, pat->mat[0].off);
+	expect(3, pat->mat[0].ext);
+	expect(-1, pat_execute_n(pat, buf, 5));
+	expect(-1, pat_execute_n(pat, buf, 0));
+	try(pat_free(pat));
+
+	try(pat_compile(pat, "(a.)c"));
+	expect(0, pat_execute_n(pat, buf + 6, sizeof buf - 7));
+	expect(1, pat->mat[0].off);
+	expect(3, pat->mat[0].ext);
+	expect(1, pat->mat[1].off);
+	expect(2, pat->mat[1].ext);
+	expect(-1, pat_execute_n(pat, buf + 11, 3));
+	try(pat_free(pat));
+
+	try(pat_compile(pat, "a.c"));
+	expect(0, pat_execute_n(pat, buf + 7, 3));
+	expect(0, pat->mat[0].off);
+	expect(-1, pat_execute_n(pat, buf + 11, 3));
+}
+
+void
+test_span(void)
+{
+	char const txt[] = "xaby xaabbby";
+	struct patiter it[1];
+	struct patmatch mat;
+
+	/* groups no longer keep a pattern off the faster engines */
+	try(pat_compile(pat, "x(a+)(b+)y"));
+	ok(pat->sft != 0x0);
+
+	try(pat_iter_init(it, pat, txt, strlen(txt)));
+	expect(0, pat_next(it, &mat));
+	expect(3, pat->nmat);
+	expect(1, pat->mat[1].off);
+	expect(1, pat->mat[2].ext);
+	expect(0, pat_next(it, &mat));
+	expect(5, pat->mat[0].off);
+	expect(6, pat->mat[1].off);
+	expect(2, pat->mat[1].ext);
+	expect(8, pat->mat[2].off);
+	expect(3, pat->mat[2].ext);
+	expect(-1, pat_next(it, &mat));
+	pat_iter_fini(it);
+	try(pat_free(pat));
+
+	try(pat_compile(pat, "(abcdefgh){9}(z)"));
+	ok(pat->dfa != 0x0);
+	expect(-1, pat_execute(pat, "abcdefghz"));
+	expect(0, pat_execute(pat, "zabcdefghabcdefghabcdefghabcdefghabcdefghabcdefghabcdefghabcdefghabcdefghz"));
+	expect(11, pat->nmat);
+	expect(1, pat->mat[0].off);
+	expect(65, pat->mat[9].off);
+	expect(73, pat->mat[10].off);
+}
+
+void
+test_stream(void)
+{
+	struct patstream *ps;
+	struct patmatch mat[64];
+	struct a *a = 0x0;
+	struct b *b = 0x0;
+	size_t len;
+	size_t siz;
+	size_t i;
+
+	for (a = cur; a->pat; ++a) {
+		try(pat_free(pat));
+		try(pat_compile(pat, a->pat));
+
+		for (b = a->accept; b && b->txt; ++b) {
+			expect(0, pat_execute(pat, b->txt));
+			memcpy(mat, pat->mat, pat->nmat * sizeof *mat);
+			len = strlen(b->txt);
+
+			for (siz = 1; siz <= len; ++siz) {
+				expect(0, pat_begin(&ps, pat));
+
+				for (i = 0; i < len; i += siz) {
+					expect(0, pat_feed(ps, b->txt + i, umin(siz, len - i)));
+				}
+
+				expectf(0, pat_finish(ps),
+				        "couldn't match '%s' over '%s' in chunks of %zu",
+				        a->pat, b->txt, siz);
+
+				for (i = 0; i < pat->nmat; ++i) {
+					expect(mat[i].off, pat->mat[i].off);
+					expect(mat[i].ext, pat->mat[i].ext);
+				}
+			}
+		}
+	}
+}
+
+void
+test_set(void)
+{
+	char const *src[] = {
+		"abc", "b+d", "x", "a|q", "(c)d", "d*", "a(b|c)*d", "\\.",
+	};
+	char const *txt[] = {
+		"abc", "bbd", "acd", "cd.", "xyz", "", "abcbcd", "zzz",
+	};
+	struct patset set[1];
+	struct pattern pat[1];
+	size_t i;
+	size_t j;
+	size_t k;
+
+	try(pat_set_compile(set, src, array_len(src)));
+
+	for (i = 0; i < array_len(txt); ++i) {
+		try(pat_set_execute(set, txt[i]));
+
+		for (j = 0; j < array_len(src); ++j) {
+			try(pat_compile(pat, src[j]));
+
+			for (k = 0; k < set->nmat; ++k) if (set->mat[k] == j) break;
+
+			expectf(pat_execute(pat, txt[i]) == 0, k < set->nmat,
+			        "set disagrees on '%s' over '%s'", src[j], txt[i]);
+
+			pat_free(pat);
+		}
+	}
+
+	pat_set_free(set);
+
+	try(pat_set_compile(set, src, 3));
+	expect(-1, pat_set_execute(set, "zzz"));
+	expect(0, set->nmat);
+	pat_set_free(set);
+}
+
+void
+test_iter(void)
+{
+	struct {
+		char const *pat;
+		int flags;
+		char const *txt;
+		struct patmatch *mat;
+	} const tab[] = {
+		{ "[a-z]+", 0, "ab cd  e", subm({0, 2}, {3, 2}, {7, 1}) },
+		{ "a*", 0, "baaa", subm({0, 0}, {1, 3}) },
+		{ "x*", 0, "", subm({0, 0}) },
+		{ "^a", 0, "aaa", subm({0, 1}) },
+		{ "a", PAT_ANCHORED, "aaba", subm({0, 1}, {1, 1}) },
+		{ "a|^b", PAT_ANCHORED, "baab", subm({0, 1}, {1, 1}, {2, 1}) },
+		{ "(a)b?", 0, "xab a", subm({1, 2}, {4, 1}) },
+		{ "a$", 0, "aa", subm({1, 1}) },
+	};
+	struct patiter it[1];
+	struct patmatch mat;
+	size_t i;
+	size_t j;
+
+	for (i = 0; i < array_len(tab); ++i) {
+		try(pat_free(pat));
+		try(pat_compile_flags(pat, tab[i].pat, tab[i].flags));
+		try(pat_iter_init(it, pat, tab[i].txt, strlen(tab[i].txt)));
+
+		for (j = 0; tab[i].mat[j].off != -1UL; ++j) {
+			expectf(0, pat_next(it, &mat), "missed match %zu of '%s' in '%s'",
+			        j, tab[i].pat, tab[i].txt);
+			expect(tab[i].mat[j].off, mat.off);
+			expect(tab[i].mat[j].ext, mat.ext);
+		}
+
+		expect(-1, pat_next(it, &mat));
+		expect(-1, pat_next(it, &mat));
+		pat_iter_fini(it);
+	}
+
+	/* submatches land in the pattern as usual, counted from the buffer */
+	try(pat_free(pat));
+	try(pat_compile(pat, "(a)(b)"));
+	try(pat_iter_init(it, pat, "ab ab", 5));
+	expect(0, pat_next(it, &mat));
+	expect(0, pat_next(it, &mat));
+	expect(3, pat->mat[1].off);
+	expect(4, pat->mat[2].off);
+	pat_iter_fini(it);
+}
+
+void
+test_scan(void)
+{
+	struct {
+		char const *pat;
+		int flags;
+	} const tab[] = {
+		{ "ab*c", 0 },
+		{ "a[a-d]*d", 0 },
+		{ "(ab|b)c", 0 },
+		{ "b*", 0 },
+		{ "^a", 0 },
+		{ "d$", 0 },
+		{ "[ab]", PAT_ANCHORED },
+	};
+	static char txt[1 << 18];
+	unsigned long r = 1;
+	struct patiter it[1];
+	struct patmatch mat;
+	struct patmatch *res;
+	size_t len = sizeof txt;
+	size_t cnt;
+	size_t n;
+	size_t i;
+	size_t j;
+
+	for (i = 0; i < len; ++i) {
+		r = r * 1103515245 + 12345;
+		txt[i] = "abcd"[r >> 16 & 3];
+	}
+
+	for (i = 0; i < array_len(tab); ++i) {
+		try(pat_free(pat));
+		try(pat_compile_flags(pat, tab[i].pat, tab[i].flags));
+		expect(0, pat_scan(pat, txt, len, 4, &res, &n));
+		expect(0, pat_count(pat, txt, len, 4, &cnt));
+		expectf(n, cnt, "counting '%s'", tab[i].pat);
+
+		/* in order, and just what pat_next finds, chunk edges or not */
+		try(pat_iter_init(it, pat, txt, len));
+
+		for (j = 0; !pat_next(it, &mat); ++j) {
+			expectf(true, j < n, "missed match %zu of '%s'", j, tab[i].pat);
+			expect(mat.off, res[j].off);
+			expect(mat.ext, res[j].ext);
+		}
+
+		expectf(j, n, "scanning '%s'", tab[i].pat);
+
+		pat_iter_fini(it);
+		free(res);
+	}
+}
 
 void
 test_free()
 {
 	pat_free(pat);
 	memset(pat, 0, sizeof *pat);
+	pat_matcher_free(pm);
+	pm = 0x0;
 }
 
 void
@@ -277,7 +1021,7 @@ test_match(void)
 		expectf(0, pat_compile(pat, a->pat), "couldn't compile: '%s'", a->pat);
 
 		for (b = a->accept; b && b->txt; ++b) {
-			expectf(0, pat_execute(pat, b->txt),
+			expectf(0, execute(b->txt),
 			        "couldn't match '%s' over '%s'", a->pat, b->txt);
 
 			for (i = 0; i < pat->nmat; ++i) {
@@ -292,7 +1036,113 @@ test_match(void)
 		}
 
 		for (b = a->reject; b && b->txt; ++b) {
-			expect(-1, pat_execute(pat, b->txt));
+			expect(-1, execute(b->txt));
 		}
 	}
 }
+
+void
+fill(char *dst, size_t len, struct a *a)
+{
+	/* bytes from the pattern's examples, and some past ascii */
+	char set[256] = "\x80\xe9\xff";
+	unsigned long r = 1;
+	size_t n = strlen(set);
+	size_t i;
+	struct b *b;
+
+	for (b = a->accept; b && b->txt; ++b) {
+		for (i = 0; b->txt[i] && n < sizeof set - 1; ++i) set[n++] = b->txt[i];
+	}
+
+	for (b = a->reject; b && b->txt; ++b) {
+		for (i = 0; b->txt[i] && n < sizeof set - 1; ++i) set[n++] = b->txt[i];
+	}
+
+	for (i = 0; i < len - 1; ++i) {
+		r = r * 1103515245 + 12345;
+		dst[i] = set[(r >> 16) % n];
+	}
+
+	dst[len - 1] = 0;
+}
+
+void
+test_agree(void)
+{
+	struct patmatch want[1024];
+	struct context ctx[1];
+	struct onepass *one;
+	struct shift *sft;
+	struct dfa *dfa;
+	struct a *a;
+	char txt[4096];
+	size_t nmat;
+	size_t len;
+	size_t n;
+	size_t i;
+	int err;
+
+	for (a = cur; a->pat; ++a) {
+		try(pat_free(pat));
+		expectf(0, pat_compile(pat, a->pat), "couldn't compile: '%s'", a->pat);
+		fill(txt, sizeof txt, a);
+
+		/* each engine that can take the program, whatever pat_compile picked */
+		len = prog_len(pat->prog);
+		sft = 0x0;
+		dfa = 0x0;
+		one = 0x0;
+
+		if (!prog_vm(pat->prog, len)) {
+			if (shift_fits(pat->prog, len)) expect(0, shift_alloc(&sft, pat->prog, len, 0x0));
+			expect(0, dfa_alloc(&dfa, pat->prog, len));
+		}
+
+		err = one_alloc(&one, pat->prog, len, 0x0);
+		if (err != ENOTSUP) expect(0, err);
+
+		for (i = 0; i < sizeof txt - 1; i += 97) {
+			n = umin(strlen(txt + i), 256);
+
+			memset(ctx, 0, sizeof *ctx);
+			ctx->str = txt + i;
+			ctx->len = n;
+			err = pat_match(pat, ctx);
+
+			nmat = err ? 0 : pat->nmat;
+			ok(nmat <= array_len(want));
+			memcpy(want, pat->mat, nmat * sizeof *want);
+
+			if (sft) {
+				expectf(err, shift_match(pat, sft, txt + i, n, -1), "shift-and on '%s' at %zu", a->pat, i);
+				if (!err) ok(!memcmp(want, pat->mat, sizeof *want));
+			}
+
+			if (dfa) {
+				expectf(err, dfa_match(pat, dfa, txt + i, n, -1), "dfa on '%s' at %zu", a->pat, i);
+				if (!err) ok(!memcmp(want, pat->mat, sizeof *want));
+			}
+
+			if (err) continue;
+
+			/* the rest fill in submatches over the span the vm found */
+			if (one) {
+				expectf(0, one_match(pat, one, txt + i, want->off, want->off + want->ext), "one-pass on '%s' at %zu", a->pat, i);
+				expect(nmat, pat->nmat);
+				ok(!memcmp(want, pat->mat, nmat * sizeof *want));
+			}
+
+			err = back_match(pat, txt + i, want->off, want->off + want->ext);
+			if (err == ENOTSUP) continue;
+
+			expectf(0, err, "backtracking on '%s' at %zu", a->pat, i);
+			expect(nmat, pat->nmat);
+			ok(!memcmp(want, pat->mat, nmat * sizeof *want));
+		}
+
+		shift_free(sft);
+		dfa_free(dfa);
+		one_free(one);
+	}
+}
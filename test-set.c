@@ -13,6 +13,7 @@ static void test_add(void);
 static void test_free(void);
 static void test_query(void);
 static void test_remove(void);
+static void test_remove_some(void);
 static void test_fixed(void);
 static void test_prefix(void);
 static void test_large_add(void);
@@ -25,6 +26,7 @@ struct test unit_tests[] = {
 	{ "inserting a string",                  0x0,         test_add,       test_free, },
 	{ "querying the set",                    test_add,    test_query,     test_free, },
 	{ "removing an element",                 test_add,    test_remove,    test_free, },
+	{ "removing some and keeping the rest",  test_alloc,  test_remove_some, test_free, },
 	{ "querying with a fixed-size buffer",   test_add,    test_fixed,     test_free, },
 	{ "testing the prefix check",            test_add,    test_prefix,    test_free, },
 	{ "adding a large number of strings",    test_alloc,  test_large_add, test_free, },
@@ -100,6 +102,31 @@ test_remove(void)
 	}
 }
 
+void
+test_remove_some(void)
+{
+	char key[16];
+	size_t i;
+
+	for (i = 0; i < 12; ++i) {
+		sprintf(key, "x%zuy", i);
+		expect(0, set_add_string(set, key));
+	}
+
+	for (i = 0; i < 6; ++i) {
+		sprintf(key, "x%zuy", i);
+		expect(0, set_remove_string(set, key));
+		expect(ENOENT, set_remove_string(set, key));
+	}
+
+	for (i = 0; i < 12; ++i) {
+		sprintf(key, "x%zuy", i);
+		expect(i >= 6, set_contains_string(set, key));
+	}
+
+	expect(6, set_query_string(0x0, 0, set, "x"));
+}
+
 void
 test_prefix(void)
 {